@@ -0,0 +1,74 @@
+#ifndef AGGREGATE_HPP
+#define AGGREGATE_HPP
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+/*
+    Aggregate policies for Tree<T, K, Aggregate>: the tree keeps, for every node, the aggregate of the
+    values in the subtree rooted there.
+    A policy defines
+        using value_type = ...;                       // the aggregate
+        static value_type lift(const T &value);       // the aggregate of a single value
+        static value_type combine(const value_type &, const value_type &); // associative
+    The subtree aggregate is combine(lift(node), children's aggregates...) in pre-order, so combine does not
+    have to be commutative. A subtree is never empty, so no identity element is needed.
+*/
+
+template <typename T>
+struct SumAggregate
+{
+    using value_type = T;
+    static value_type lift(const T &value) { return value; }
+    static value_type combine(const value_type &a, const value_type &b) { return a + b; }
+};
+
+// The smallest / largest value by operator< (for Complex: by magnitude).
+template <typename T>
+struct MinAggregate
+{
+    using value_type = T;
+    static value_type lift(const T &value) { return value; }
+    static value_type combine(const value_type &a, const value_type &b) { return b < a ? b : a; }
+};
+
+template <typename T>
+struct MaxAggregate
+{
+    using value_type = T;
+    static value_type lift(const T &value) { return value; }
+    static value_type combine(const value_type &a, const value_type &b) { return a < b ? b : a; }
+};
+
+template <typename T>
+struct CountAggregate
+{
+    using value_type = std::size_t;
+    static value_type lift(const T &) { return 1; }
+    static value_type combine(value_type a, value_type b) { return a + b; }
+};
+
+// Several aggregates at once; value_type is a std::tuple with one entry per policy, in order.
+template <typename... Policies>
+struct Aggregates
+{
+    using value_type = std::tuple<typename Policies::value_type...>;
+
+    template <typename T>
+    static value_type lift(const T &value) { return value_type(Policies::lift(value)...); }
+
+    static value_type combine(const value_type &a, const value_type &b)
+    {
+        return combine_each(a, b, std::index_sequence_for<Policies...>());
+    }
+
+private:
+    template <std::size_t... I>
+    static value_type combine_each(const value_type &a, const value_type &b, std::index_sequence<I...>)
+    {
+        return value_type(Policies::combine(std::get<I>(a), std::get<I>(b))...);
+    }
+};
+
+#endif // AGGREGATE_HPP
@@ -0,0 +1,773 @@
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "node.hpp"
+#include "node_pool.hpp"
+#include "tree.hpp"
+#include "compact_tree.hpp"
+#include "implicit_tree.hpp"
+#include "thread_pool.hpp"
+#include "dary_heap.hpp"
+#include "complex.hpp"
+#include "complex_array.hpp"
+#include <algorithm>
+#include <random>
+#include <queue>
+
+/*
+    Benchmarks for the tree containers.
+    Usage: ./bench [n]   (n = number of nodes, default 1000000; e.g. ./bench 10000000)
+
+    - Node allocation: per-node new/delete vs. NodePool
+    - Tree build: add_sub_node by parent value at growing sizes (should scale linearly)
+    - Traversals: BFS/DFS over the pointer Tree vs. the structure-of-arrays CompactTree / frozen layouts
+    - Implicit tree: BFS/DFS by index arithmetic, Eytzinger lower_bound vs. std::lower_bound
+    - Frozen layouts: random root-to-leaf searches in BFS, DFS and van Emde Boas layout (./bench 16777215 for 2^24)
+    - Deep chains: recursive reference vs. the explicit-stack helpers, then a 10*n deep chain (10M by default)
+    - Parallel BFS: sequential scan vs. parallel_bfs_into on a wide 16-ary tree, 1 .. hardware threads
+    - Parallel reduce: copy out with begin_dfs_scan and fold vs. parallel_reduce, 1 .. hardware threads
+    - Selection: the 10 smallest values via begin_heap (cold) vs. top_k, kth of the median and near the end
+    - D-ary heap: push n random keys and pop them all, std::priority_queue vs. DaryHeap with K = 2, 4, 8
+      (plus n decrease_key calls in between)
+    - Complex array: magnitudes and products over n values, vector<Complex> vs. the SIMD ComplexArray
+      (build with CXXFLAGS+=-mavx2 for the AVX2 kernels; SSE2 otherwise)
+    - Order keys: sorting a Tree<Complex> by comparing magnitude() vs. the keyed sort (heap_into), the keyed
+      heap drained one pop per step, and top_k; magnitudes by DFS over the Tree vs. the SIMD kernel over the
+      frozen CompactTree<Complex>, whose value store is a ComplexArray
+    - Subtree aggregates: build cost of a SumAggregate tree, subtree sums by DFS vs. subtree_aggregate
+*/
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static void report(const char *name, size_t n, double ms, const char *unit = "node")
+{
+    cout << "  " << name << ": " << ms << " ms (" << (ms * 1e6 / n) << " ns/" << unit << ")" << endl;
+}
+
+// Deletes a tree built with per-node new, the way Tree::delete_tree did before the pool.
+static void delete_heap_tree(Node<int> *node)
+{
+    if (node == nullptr)
+        return;
+    for (auto child : node->get_children())
+    {
+        delete_heap_tree(child);
+    }
+    delete node;
+}
+
+static void bench_node_allocation(size_t n)
+{
+    cout << "Node allocation, complete binary tree of " << n << " nodes" << endl;
+    vector<Node<int> *> nodes(n);
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < n; i++)
+    {
+        nodes[i] = new Node<int>((int)i);
+        if (i > 0)
+            nodes[(i - 1) / 2]->add_child(nodes[i]);
+    }
+    report("build, per-node new", n, elapsed_ms(start));
+    start = Clock::now();
+    delete_heap_tree(nodes[0]);
+    report("teardown, per-node delete", n, elapsed_ms(start));
+
+    start = Clock::now();
+    {
+        NodePool<Node<int>> pool;
+        for (size_t i = 0; i < n; i++)
+        {
+            nodes[i] = pool.create((int)i);
+            if (i > 0)
+                nodes[(i - 1) / 2]->add_child(nodes[i]);
+        }
+        report("build, NodePool", n, elapsed_ms(start));
+        start = Clock::now();
+        for (size_t i = 0; i < n; i++)
+        {
+            pool.destroy(nodes[i]);
+        }
+    }
+    report("teardown, NodePool", n, elapsed_ms(start));
+}
+
+static void bench_tree_build(size_t n)
+{
+    cout << "Tree build by parent value (value index)" << endl;
+    for (size_t size = n >= 100 ? n / 100 : n; size <= n; size *= 10)
+    {
+        auto start = Clock::now();
+        {
+            Tree<int> tree;
+            tree.add_root(Node<int>(0));
+            for (size_t i = 1; i < size; i++)
+            {
+                tree.add_sub_node(Node<int>((int)((i - 1) / 2)), Node<int>((int)i));
+            }
+        }
+        report(("build + teardown, " + to_string(size) + " nodes").c_str(), size, elapsed_ms(start));
+    }
+}
+
+// Complete binary tree with values 0..n-1 in BFS order, built through handles.
+static void build_complete_tree(Tree<int> &tree, size_t n)
+{
+    vector<Tree<int>::NodeHandle> handles(n);
+    handles[0] = tree.add_root(Node<int>(0));
+    for (size_t i = 1; i < n; i++)
+    {
+        handles[i] = tree.add_sub_node(handles[(i - 1) / 2], (int)i);
+    }
+}
+
+template <typename It, typename Value>
+static long long sum_traversal(It begin, It end, Value value)
+{
+    long long sum = 0;
+    for (auto it = begin; it != end; ++it)
+    {
+        sum += value(it);
+    }
+    return sum;
+}
+
+static void bench_traversals(size_t n)
+{
+    cout << "Traversals over a complete binary tree of " << n << " nodes" << endl;
+    Tree<int> tree;
+    build_complete_tree(tree, n);
+    CompactTree<int> compact(tree);
+    cout << "  footprint: Tree " << sizeof(Tree<int>::node_type) * n / 1024 << " KiB, CompactTree "
+         << (sizeof(int) + 3 * sizeof(uint32_t)) * n / 1024 << " KiB" << endl;
+
+    auto node_value = [](const Tree<int>::dfs_iterator &it) { return (*it)->get_value(); };
+    auto bfs_node_value = [](const Tree<int>::bfs_iterator &it) { return (*it)->get_value(); };
+    auto compact_value = [](const CompactTree<int>::Iterator &it) { return *it; };
+    const long long expected = (long long)n * (long long)(n - 1) / 2;
+    bool mismatch = false;
+
+    auto start = Clock::now();
+    mismatch |= sum_traversal(tree.begin_bfs_scan(), tree.end_bfs_scan(), bfs_node_value) != expected;
+    report("BFS, Tree", n, elapsed_ms(start));
+    start = Clock::now();
+    mismatch |= sum_traversal(compact.begin_bfs_scan(), compact.end_bfs_scan(), compact_value) != expected;
+    report("BFS, CompactTree", n, elapsed_ms(start));
+
+    start = Clock::now();
+    mismatch |= sum_traversal(tree.begin_dfs_scan(), tree.end_dfs_scan(), node_value) != expected;
+    report("DFS, Tree", n, elapsed_ms(start));
+    start = Clock::now();
+    mismatch |= sum_traversal(compact.begin_dfs_scan(), compact.end_dfs_scan(), compact_value) != expected;
+    report("DFS, CompactTree (BFS layout)", n, elapsed_ms(start));
+
+    auto frozen_dfs = freeze(tree, CompactLayout::DepthFirst);
+    start = Clock::now();
+    mismatch |= sum_traversal(frozen_dfs.begin_dfs_scan(), frozen_dfs.end_dfs_scan(), compact_value) != expected;
+    report("DFS, frozen DFS layout", n, elapsed_ms(start));
+
+    start = Clock::now();
+    long long sum = 0;
+    for (int value : compact.values())
+    {
+        sum += value;
+    }
+    mismatch |= sum != expected;
+    report("value scan, CompactTree", n, elapsed_ms(start));
+
+    if (mismatch)
+        cout << "  traversal sums differ!" << endl;
+}
+
+static void bench_implicit(size_t n)
+{
+    cout << "Implicit (pointer-free) complete binary tree of " << n << " nodes" << endl;
+    Tree<int> tree;
+    build_complete_tree(tree, n);
+    ImplicitTree<int> implicit(tree);
+    auto value = [](const ImplicitTree<int>::Iterator &it) { return *it; };
+    const long long expected = (long long)n * (long long)(n - 1) / 2;
+    bool mismatch = false;
+
+    auto start = Clock::now();
+    mismatch |= sum_traversal(implicit.begin_bfs_scan(), implicit.end_bfs_scan(), value) != expected;
+    report("BFS, ImplicitTree", n, elapsed_ms(start));
+    start = Clock::now();
+    mismatch |= sum_traversal(implicit.begin_dfs_scan(), implicit.end_dfs_scan(), value) != expected;
+    report("DFS, ImplicitTree", n, elapsed_ms(start));
+
+    vector<int> sorted(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sorted[i] = (int)(2 * i);
+    }
+    auto eytzinger = ImplicitTree<int>::from_sorted(sorted);
+    mt19937 rng(42);
+    uniform_int_distribution<int> pick(0, (int)(2 * n));
+    vector<int> queries(1000000);
+    for (auto &q : queries)
+    {
+        q = pick(rng);
+    }
+
+    long long hits = 0;
+    start = Clock::now();
+    for (int q : queries)
+    {
+        hits += lower_bound(sorted.begin(), sorted.end(), q) != sorted.end();
+    }
+    report("1M searches, std::lower_bound on sorted array", queries.size(), elapsed_ms(start), "search");
+    start = Clock::now();
+    for (int q : queries)
+    {
+        hits -= eytzinger.lower_bound(q) != ImplicitTree<int>::NONE;
+    }
+    report("1M searches, Eytzinger lower_bound", queries.size(), elapsed_ms(start), "search");
+
+    if (mismatch || hits != 0)
+        cout << "  results differ!" << endl;
+}
+
+// Root-to-leaf binary search through a frozen binary search tree.
+static uint32_t search_path(const CompactTree<int> &tree, int key)
+{
+    uint32_t node = 0;
+    uint32_t last = node;
+    while (node != CompactTree<int>::NONE)
+    {
+        last = node;
+        int value = tree.value(node);
+        if (key == value)
+            break;
+        uint32_t child = tree.get_first_child(node);
+        if (key > value && child != CompactTree<int>::NONE)
+            child = tree.get_next_sibling(child);
+        node = child;
+    }
+    return last;
+}
+
+static void bench_layouts(size_t n)
+{
+    cout << "Random root-to-leaf searches in a frozen binary search tree of " << n << " nodes" << endl;
+    vector<int> sorted(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sorted[i] = (int)i;
+    }
+    vector<int> bst = ImplicitTree<int>::from_sorted(sorted).values(); // complete BST in BFS order
+    sorted = vector<int>();
+
+    Tree<int> tree;
+    {
+        vector<Tree<int>::NodeHandle> handles(n);
+        handles[0] = tree.add_root(Node<int>(bst[0]));
+        for (size_t i = 1; i < n; i++)
+        {
+            handles[i] = tree.add_sub_node(handles[(i - 1) / 2], bst[i]);
+        }
+    }
+
+    mt19937 rng(7);
+    uniform_int_distribution<int> pick(0, (int)n - 1);
+    vector<int> keys(1000000);
+    for (auto &k : keys)
+    {
+        k = pick(rng);
+    }
+
+    const pair<const char *, CompactLayout> layouts[] = {
+        {"BFS layout", CompactLayout::BreadthFirst},
+        {"DFS layout", CompactLayout::DepthFirst},
+        {"vEB layout", CompactLayout::VanEmdeBoas}};
+    for (auto &layout : layouts)
+    {
+        auto frozen = freeze(tree, layout.second);
+        unsigned long long found = 0;
+        auto start = Clock::now();
+        for (int k : keys)
+        {
+            found += frozen.value(search_path(frozen, k)) == k;
+        }
+        report(layout.first, keys.size(), elapsed_ms(start), "search");
+        if (found != keys.size())
+            cout << "  searches failed!" << endl;
+    }
+}
+
+// A value without std::hash, so add_sub_node by value has to search with find_node.
+struct Unhashed
+{
+    int value;
+    bool operator==(const Unhashed &other) const { return value == other.value; }
+};
+
+// The recursive pre-order collection the tree used before its helpers became iterative.
+template <typename N>
+static void recursive_dfs(N *node, vector<N *> &result)
+{
+    if (node == nullptr)
+        return;
+    result.push_back(node);
+    for (auto child : node->get_children())
+    {
+        recursive_dfs(child, result);
+    }
+}
+
+static void bench_deep_chain(size_t n)
+{
+    const size_t shallow = 100000; // still fits the default call stack when recursing
+    cout << "Chain of " << shallow << " nodes: recursive vs. explicit stack" << endl;
+    {
+        Tree<int> chain;
+        auto node = chain.add_root(Node<int>(0));
+        for (size_t i = 1; i < shallow; i++)
+        {
+            node = chain.add_sub_node(node, (int)i);
+        }
+        vector<Tree<int>::node_type *> nodes;
+        nodes.reserve(shallow);
+        auto start = Clock::now();
+        for (int round = 0; round < 10; round++)
+        {
+            nodes.clear();
+            recursive_dfs(chain.getRoot(), nodes);
+        }
+        report("10x recursive pre-order", 10 * shallow, elapsed_ms(start));
+        start = Clock::now();
+        for (int round = 0; round < 10; round++)
+        {
+            nodes.clear();
+            for (auto it = chain.begin_pre_order(); it != chain.end_pre_order(); ++it)
+            {
+                nodes.push_back(*it);
+            }
+        }
+        report("10x explicit-stack pre-order", 10 * shallow, elapsed_ms(start));
+    }
+
+    size_t depth = 10 * n;
+    cout << "Chain of " << depth << " nodes (would overflow a recursive helper)" << endl;
+    Tree<Unhashed> chain;
+    auto start = Clock::now();
+    auto node = chain.add_root(Node<Unhashed>(Unhashed{0}));
+    for (size_t i = 1; i < depth; i++)
+    {
+        node = chain.add_sub_node(node, Unhashed{(int)i});
+    }
+    report("build through handles", depth, elapsed_ms(start));
+
+    start = Clock::now();
+    chain.add_sub_node(Node<Unhashed>(Unhashed{(int)depth - 1}), Node<Unhashed>(Unhashed{(int)depth}));
+    report("find_node of the deepest node", depth, elapsed_ms(start));
+
+    start = Clock::now();
+    long long sum = 0;
+    for (auto it = chain.begin_post_order(); it != chain.end_post_order(); ++it)
+    {
+        sum += (*it)->get_value().value;
+    }
+    report("post-order", depth, elapsed_ms(start));
+    if (sum != (long long)depth * (long long)(depth + 1) / 2)
+        cout << "  post-order sum is wrong!" << endl;
+}
+
+static void bench_parallel_bfs(size_t n)
+{
+    cout << "Parallel BFS, complete 16-ary tree of " << n << " nodes" << endl;
+    using WideTree = Tree<int, 16>;
+    WideTree tree;
+    vector<WideTree::NodeHandle> handles;
+    handles.reserve(n);
+    handles.push_back(tree.add_root(Node<int>(0)));
+    for (size_t i = 1; i < n; i++)
+    {
+        handles.push_back(tree.add_sub_node(handles[(i - 1) / 16], (int)i));
+    }
+    handles.clear();
+    handles.shrink_to_fit();
+
+    vector<const WideTree::node_type *> expected;
+    expected.reserve(n);
+    auto start = Clock::now();
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it)
+    {
+        expected.push_back(*it);
+    }
+    report("sequential begin_bfs_scan", n, elapsed_ms(start));
+
+    size_t hardware = max(1u, thread::hardware_concurrency());
+    vector<const WideTree::node_type *> out;
+    out.reserve(n);
+    for (size_t threads = 1;; threads = min(threads * 2, hardware))
+    {
+        ThreadPool pool(threads);
+        start = Clock::now();
+        tree.parallel_bfs_into(out, pool);
+        double ms = elapsed_ms(start);
+        string name = "parallel_bfs_into, " + to_string(threads) + " thread(s)";
+        report(name.c_str(), n, ms);
+        if (out != expected)
+            cout << "  parallel order differs from the sequential scan!" << endl;
+        if (threads == hardware)
+            break;
+    }
+}
+
+static void bench_parallel_reduce(size_t n)
+{
+    cout << "Parallel reduce, sum over a complete binary tree of " << n << " nodes" << endl;
+    Tree<int> tree;
+    build_complete_tree(tree, n);
+    long long expected = (long long)n * (long long)(n - 1) / 2;
+
+    auto start = Clock::now();
+    vector<int> values;
+    for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it)
+    {
+        values.push_back((*it)->get_value());
+    }
+    long long sum = 0;
+    for (int value : values)
+    {
+        sum += value;
+    }
+    report("begin_dfs_scan copy + serial fold", n, elapsed_ms(start));
+    if (sum != expected)
+        cout << "  serial sum is wrong!" << endl;
+
+    size_t hardware = max(1u, thread::hardware_concurrency());
+    for (size_t threads = 1;; threads = min(threads * 2, hardware))
+    {
+        ThreadPool pool(threads);
+        start = Clock::now();
+        sum = tree.parallel_reduce([](int value) { return (long long)value; },
+                                   [](long long a, long long b) { return a + b; }, 0LL, pool);
+        double ms = elapsed_ms(start);
+        string name = "parallel_reduce, " + to_string(threads) + " thread(s)";
+        report(name.c_str(), n, ms);
+        if (sum != expected)
+            cout << "  parallel sum is wrong!" << endl;
+        if (threads == hardware)
+            break;
+    }
+}
+
+static void bench_selection(size_t n)
+{
+    cout << "Selection, binary tree of " << n << " shuffled values" << endl;
+    vector<int> values(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        values[i] = (int)i;
+    }
+    shuffle(values.begin(), values.end(), mt19937(42));
+    Tree<int> tree;
+    vector<Tree<int>::NodeHandle> handles(n);
+    handles[0] = tree.add_root(Node<int>(values[0]));
+    for (size_t i = 1; i < n; i++)
+    {
+        handles[i] = tree.add_sub_node(handles[(i - 1) / 2], values[i]);
+    }
+
+    const size_t k = 10;
+    auto start = Clock::now();
+    long long heap_sum = 0;
+    auto it = tree.begin_heap();
+    for (size_t taken = 0; taken < k && it != tree.end_heap(); taken++, ++it)
+    {
+        heap_sum += (*it)->get_value();
+    }
+    report("begin_heap, first 10 (builds the heap)", n, elapsed_ms(start));
+
+    start = Clock::now();
+    long long top_sum = 0;
+    for (auto node : tree.top_k(k))
+    {
+        top_sum += node->get_value();
+    }
+    report("top_k(10)", n, elapsed_ms(start));
+    if (heap_sum != top_sum || (n >= k && top_sum != (long long)(k * (k - 1) / 2)))
+        cout << "  top_k disagrees with the heap!" << endl;
+
+    start = Clock::now();
+    int median = tree.kth(n / 2 + 1)->get_value();
+    report("kth(n / 2 + 1)", n, elapsed_ms(start));
+    start = Clock::now();
+    int tenth_largest = tree.kth(n - 9)->get_value();
+    report("kth(n - 9) (selects the 10th largest)", n, elapsed_ms(start));
+    if (median != (int)(n / 2) || (n >= k && tenth_largest != (int)(n - 10)))
+        cout << "  kth is wrong!" << endl;
+}
+
+template <int K>
+static void bench_dary_heap_k(const vector<int> &keys, long long expected_sum)
+{
+    size_t n = keys.size();
+    string name = "DaryHeap K=" + to_string(K);
+    DaryHeap<int, K> heap;
+    heap.reserve(n);
+    vector<typename DaryHeap<int, K>::Handle> handles(n);
+    auto start = Clock::now();
+    for (size_t i = 0; i < n; i++)
+    {
+        handles[i] = heap.push(keys[i]);
+    }
+    report((name + ", push").c_str(), n, elapsed_ms(start));
+
+    start = Clock::now();
+    for (size_t i = 0; i < n; i++)
+    {
+        heap.decrease_key(handles[i], keys[i] - (int)(n / 2));
+    }
+    report((name + ", decrease_key").c_str(), n, elapsed_ms(start));
+
+    start = Clock::now();
+    long long sum = 0;
+    while (!heap.empty())
+    {
+        sum += heap.pop();
+    }
+    report((name + ", pop all").c_str(), n, elapsed_ms(start));
+    if (sum != expected_sum - (long long)n * (long long)(n / 2))
+        cout << "  DaryHeap checksum is wrong!" << endl;
+}
+
+static void bench_dary_heap(size_t n)
+{
+    cout << "D-ary heap, " << n << " random keys" << endl;
+    vector<int> keys(n);
+    mt19937 random(7);
+    for (auto &key : keys)
+    {
+        key = (int)(random() % (n * 4));
+    }
+
+    auto start = Clock::now();
+    priority_queue<int, vector<int>, greater<int>> queue;
+    for (int key : keys)
+    {
+        queue.push(key);
+    }
+    report("std::priority_queue, push", n, elapsed_ms(start));
+    start = Clock::now();
+    long long sum = 0;
+    while (!queue.empty())
+    {
+        sum += queue.top();
+        queue.pop();
+    }
+    report("std::priority_queue, pop all", n, elapsed_ms(start));
+
+    bench_dary_heap_k<2>(keys, sum);
+    bench_dary_heap_k<4>(keys, sum);
+    bench_dary_heap_k<8>(keys, sum);
+}
+
+static void bench_complex_array(size_t n)
+{
+    cout << "Complex array, " << n << " values, " << complex_simd::WIDTH << " doubles per SIMD pack, 10 rounds" << endl;
+    const int rounds = 10;
+    vector<Complex> a, b;
+    a.reserve(n);
+    b.reserve(n);
+    mt19937 random(3);
+    uniform_real_distribution<double> uniform(-100.0, 100.0);
+    for (size_t i = 0; i < n; i++)
+    {
+        a.push_back(Complex(uniform(random), uniform(random)));
+        b.push_back(Complex(uniform(random), uniform(random)));
+    }
+    ComplexArray xs(a), ys(b);
+
+    vector<double> magnitudes(n);
+    auto start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            magnitudes[i] = a[i].magnitude();
+        }
+    }
+    report("magnitude, vector<Complex>", n * rounds, elapsed_ms(start), "value");
+    double scalar_sum = 0;
+    for (double m : magnitudes)
+    {
+        scalar_sum += m;
+    }
+
+    start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        xs.magnitude(magnitudes);
+    }
+    report("magnitude, ComplexArray", n * rounds, elapsed_ms(start), "value");
+    double simd_sum = 0;
+    for (double m : magnitudes)
+    {
+        simd_sum += m;
+    }
+
+    vector<Complex> products = a;
+    start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            products[i] *= b[i];
+        }
+    }
+    report("multiply in place, vector<Complex>", n * rounds, elapsed_ms(start), "value");
+
+    ComplexArray simd_products = xs;
+    start = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        simd_products *= ys;
+    }
+    report("multiply in place, ComplexArray", n * rounds, elapsed_ms(start), "value");
+
+    if (abs(scalar_sum - simd_sum) > 1e-6 * abs(scalar_sum) || abs(simd_products[n - 1].get_real() - products[n - 1].get_real()) > 1e-9 * abs(products[n - 1].get_real()))
+        cout << "  ComplexArray results differ from Complex!" << endl;
+}
+
+static void bench_order_keys(size_t n)
+{
+    cout << "Order keys, Tree<Complex> of " << n << " nodes" << endl;
+    Tree<Complex> tree;
+    vector<Tree<Complex>::NodeHandle> handles(n);
+    mt19937 random(5);
+    uniform_real_distribution<double> uniform(-100.0, 100.0);
+    handles[0] = tree.add_root(Node<Complex>(Complex(uniform(random), uniform(random))));
+    for (size_t i = 1; i < n; i++)
+    {
+        handles[i] = tree.add_sub_node(handles[(i - 1) / 2], Complex(uniform(random), uniform(random)));
+    }
+
+    auto start = Clock::now();
+    vector<Tree<Complex>::node_type *> nodes(tree.begin_dfs_scan(), tree.end_dfs_scan());
+    sort(nodes.begin(), nodes.end(), [](const Tree<Complex>::node_type *a, const Tree<Complex>::node_type *b) {
+        return a->get_value().magnitude() < b->get_value().magnitude();
+    });
+    report("std::sort comparing magnitude()", n, elapsed_ms(start));
+
+    start = Clock::now();
+    vector<const Tree<Complex>::node_type *> sorted;
+    tree.heap_into(sorted);
+    report("heap_into, full sort (keyed)", n, elapsed_ms(start));
+    bool same = sorted.size() == nodes.size();
+    for (size_t i = 0; same && i < n; i++)
+    {
+        same = sorted[i]->get_value().magnitude() == nodes[i]->get_value().magnitude();
+    }
+
+    start = Clock::now();
+    size_t i = 0;
+    for (auto it = tree.begin_heap(); it != tree.end_heap(); ++it, ++i)
+    {
+        same = same && (*it)->get_value().magnitude() == nodes[i]->get_value().magnitude();
+    }
+    report("begin_heap, full drain (keyed, one pop per step)", n, elapsed_ms(start));
+
+    start = Clock::now();
+    auto smallest = tree.top_k(10);
+    report("top_k(10) (keyed)", n, elapsed_ms(start));
+    for (size_t j = 0; j < smallest.size(); j++)
+    {
+        same = same && smallest[j]->get_value().magnitude() == nodes[j]->get_value().magnitude();
+    }
+
+    start = Clock::now();
+    vector<double> by_dfs;
+    by_dfs.reserve(n);
+    for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it)
+    {
+        by_dfs.push_back((*it)->get_value().magnitude());
+    }
+    report("magnitude, DFS over the Tree", n, elapsed_ms(start));
+
+    auto frozen = freeze(tree, CompactLayout::DepthFirst);
+    vector<double> by_kernel;
+    start = Clock::now();
+    frozen.values().magnitude(by_kernel);
+    report("magnitude, frozen values (ComplexArray store)", n, elapsed_ms(start));
+    for (size_t j = 0; same && j < n; j++)
+    {
+        same = abs(by_kernel[j] - by_dfs[j]) <= 1e-12 * by_dfs[j];
+    }
+    if (!same)
+        cout << "  keyed order or frozen magnitudes differ from the magnitude sort!" << endl;
+}
+
+static void bench_subtree_aggregates(size_t n)
+{
+    cout << "Subtree aggregates, complete binary tree of " << n << " nodes" << endl;
+    Tree<long long, 2, SumAggregate<long long>> tree;
+    vector<Tree<long long, 2, SumAggregate<long long>>::NodeHandle> handles(n);
+    auto start = Clock::now();
+    handles[0] = tree.add_root(Node<long long>(0));
+    for (size_t i = 1; i < n; i++)
+    {
+        handles[i] = tree.add_sub_node(handles[(i - 1) / 2], (long long)i);
+    }
+    report("build with SumAggregate (O(depth) per insert)", n, elapsed_ms(start));
+
+    // Sums of the subtrees of the first 1023 nodes (every subtree at depth < 10).
+    size_t queries = min(n, (size_t)1023);
+    start = Clock::now();
+    long long by_dfs = 0;
+    for (size_t q = 0; q < queries; q++)
+    {
+        DepthFirstIterator<const Node<long long, 2>> end;
+        for (DepthFirstIterator<const Node<long long, 2>> it(handles[q].get_node(), DepthFirstOrder::PreOrder); it != end; ++it)
+        {
+            by_dfs += (*it)->get_value();
+        }
+    }
+    report("1023 subtree sums by DFS", queries, elapsed_ms(start), "query");
+
+    start = Clock::now();
+    long long by_aggregate = 0;
+    for (size_t q = 0; q < queries; q++)
+    {
+        by_aggregate += tree.subtree_aggregate(handles[q]);
+    }
+    report("1023 subtree sums by subtree_aggregate", queries, elapsed_ms(start), "query");
+    if (by_dfs != by_aggregate)
+        cout << "  subtree sums differ!" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    if (n == 0)
+    {
+        cerr << "n must be positive" << endl;
+        return 1;
+    }
+    bench_node_allocation(n);
+    bench_tree_build(n);
+    bench_traversals(n);
+    bench_implicit(n);
+    bench_layouts(n);
+    bench_deep_chain(n);
+    bench_parallel_bfs(n);
+    bench_parallel_reduce(n);
+    bench_selection(n);
+    bench_dary_heap(n);
+    bench_complex_array(n);
+    bench_order_keys(n);
+    bench_subtree_aggregates(n);
+    return 0;
+}
@@ -0,0 +1,449 @@
+#ifndef COMPACT_TREE_HPP
+#define COMPACT_TREE_HPP
+
+#include "tree.hpp"
+#include "compact_values.hpp"
+#include "complex_array.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    CompactLayout: the order in which a CompactTree numbers (and stores) its nodes.
+    - BreadthFirst: children of a node are adjacent, a BFS scan is a linear sweep.
+    - DepthFirst: every subtree is one contiguous range, a pre-order / DFS scan is a linear sweep.
+    - VanEmdeBoas: cache-oblivious recursive layout. The tree is cut at half its height; the top part and then
+      every bottom subtree are laid out recursively, each in its own contiguous block. Any root-to-leaf walk
+      touches O(log_B n) cache lines, whatever the line size B. Meant for deep binary trees.
+*/
+enum class CompactLayout
+{
+    BreadthFirst,
+    DepthFirst,
+    VanEmdeBoas
+};
+
+/*
+    CompactTree: an immutable, structure-of-arrays snapshot of a Tree<T, K>.
+    Values live in one contiguous store, CompactValues<T>::type: a std::vector<T>, or a ComplexArray (separate
+    real and imaginary arrays) for Complex. The topology is kept in parallel uint32_t index arrays
+    (parent, first_child, next_sibling), 12 bytes per node instead of the pointer-based node's child array.
+    Nodes are numbered in the chosen layout order, so the matching traversal is a linear sweep over the
+    arrays and value scans (values()) can be vectorized by the compiler.
+    The topology is fixed, but update_values() lets bulk kernels rewrite the values in place.
+
+    It offers the same traversals as Tree. The iterators dereference to the node's value, index() gives
+    the node index. They walk the parent/sibling links and need no stack; only a BFS over the depth-first
+    layout keeps a queue.
+*/
+template <typename T, int K = 2>
+class CompactTree
+{
+public:
+    static constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+    using store_type = typename CompactValues<T>::type;
+    // const T & for a std::vector store, a T copy for stores that split the value up (ComplexArray).
+    using const_reference = decltype(std::declval<const store_type &>()[0]);
+
+    enum class Traversal
+    {
+        PreOrder,
+        InOrder,
+        PostOrder,
+        BreadthFirst
+    };
+
+    class Iterator
+    {
+    private:
+        const CompactTree *tree;
+        std::uint32_t node;
+        Traversal order;
+        bool sequential;                  // the traversal matches the layout: the next node is node + 1
+        // Pending nodes of a BFS over a non-BFS layout, from queue_head on. A vector rather than a deque,
+        // which would allocate in every iterator's constructor, end sentinels included.
+        std::vector<std::uint32_t> queue;
+        std::size_t queue_head;
+
+        std::uint32_t leftmost(std::uint32_t v) const
+        {
+            while (tree->first_child[v] != NONE)
+                v = tree->first_child[v];
+            return v;
+        }
+
+        void next_pre_order()
+        {
+            if (tree->first_child[node] != NONE)
+            {
+                node = tree->first_child[node];
+                return;
+            }
+            while (node != NONE && tree->next_sibling[node] == NONE)
+                node = tree->parent[node];
+            if (node != NONE)
+                node = tree->next_sibling[node];
+        }
+
+        void next_post_order()
+        {
+            if (tree->next_sibling[node] != NONE)
+                node = leftmost(tree->next_sibling[node]);
+            else
+                node = tree->parent[node];
+        }
+
+        // In-order is: first child's subtree, the node, the remaining children's subtrees.
+        void next_in_order()
+        {
+            std::uint32_t first = tree->first_child[node];
+            if (first != NONE && tree->next_sibling[first] != NONE)
+            {
+                node = leftmost(tree->next_sibling[first]);
+                return;
+            }
+            // The subtree of node is finished: climb until an unvisited parent or a pending sibling.
+            std::uint32_t done = node;
+            while (true)
+            {
+                std::uint32_t up = tree->parent[done];
+                if (up == NONE)
+                {
+                    node = NONE;
+                    return;
+                }
+                if (tree->first_child[up] == done)
+                {
+                    node = up;
+                    return;
+                }
+                if (tree->next_sibling[done] != NONE)
+                {
+                    node = leftmost(tree->next_sibling[done]);
+                    return;
+                }
+                done = up;
+            }
+        }
+
+        void next_breadth_first()
+        {
+            for (std::uint32_t child = tree->first_child[node]; child != NONE; child = tree->next_sibling[child])
+                queue.push_back(child);
+            if (queue_head == queue.size())
+            {
+                node = NONE;
+                return;
+            }
+            node = queue[queue_head++];
+            if (queue_head * 2 > queue.size() && queue_head >= 64)
+            {
+                // Drop the consumed half so the queue stays about as long as the widest level.
+                queue.erase(queue.begin(), queue.begin() + queue_head);
+                queue_head = 0;
+            }
+        }
+
+        // operator-> over a store that returns values: keeps the copy alive for the member access.
+        struct ArrowProxy
+        {
+            T value;
+            const T *operator->() const { return &value; }
+        };
+
+        static const T *arrow(const T &value) { return &value; }
+        static ArrowProxy arrow(T &&value) { return ArrowProxy{std::move(value)}; }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<std::is_reference<const_reference>::value, const T *, ArrowProxy>::type;
+        using reference = const_reference;
+
+        Iterator() : tree(nullptr), node(NONE), order(Traversal::PreOrder), sequential(false), queue_head(0) {}
+
+        Iterator(const CompactTree *t, Traversal traversal_order)
+            : tree(t), node(NONE), order(traversal_order), queue_head(0)
+        {
+            sequential = (order == Traversal::BreadthFirst && tree->layout == CompactLayout::BreadthFirst) ||
+                         (order == Traversal::PreOrder && tree->layout == CompactLayout::DepthFirst);
+            if (tree->size() == 0)
+                return;
+            node = (order == Traversal::InOrder || order == Traversal::PostOrder) ? leftmost(0) : 0;
+        }
+
+        std::uint32_t index() const { return node; }
+
+        reference operator*() const { return tree->values_[node]; }
+        pointer operator->() const { return arrow(tree->values_[node]); }
+
+        Iterator &operator++()
+        {
+            if (sequential)
+            {
+                node = node + 1 < tree->size() ? node + 1 : NONE;
+                return *this;
+            }
+            switch (order)
+            {
+            case Traversal::PreOrder:
+                next_pre_order();
+                break;
+            case Traversal::InOrder:
+                next_in_order();
+                break;
+            case Traversal::PostOrder:
+                next_post_order();
+                break;
+            case Traversal::BreadthFirst:
+                next_breadth_first();
+                break;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator &other) const { return node == other.node; }
+        bool operator!=(const Iterator &other) const { return node != other.node; }
+    };
+
+private:
+    CompactLayout layout;
+    store_type values_;
+    std::vector<std::uint32_t> parent;
+    std::vector<std::uint32_t> first_child;
+    std::vector<std::uint32_t> next_sibling;
+
+    // Appends the van Emde Boas order of the top `levels` levels of the subtree rooted at node.
+    void veb_order(std::uint32_t node, std::uint32_t levels, std::vector<std::uint32_t> &order) const
+    {
+        if (levels == 1)
+        {
+            order.push_back(node);
+            return;
+        }
+        std::uint32_t top = levels / 2;
+        veb_order(node, top, order);
+
+        // Roots of the bottom subtrees: the nodes exactly `top` levels below node, left to right.
+        std::vector<std::uint32_t> frontier(1, node);
+        std::vector<std::uint32_t> below;
+        for (std::uint32_t level = 0; level < top && !frontier.empty(); level++)
+        {
+            below.clear();
+            for (std::uint32_t v : frontier)
+            {
+                for (std::uint32_t child = first_child[v]; child != NONE; child = next_sibling[child])
+                    below.push_back(child);
+            }
+            frontier.swap(below);
+        }
+        for (std::uint32_t root : frontier)
+        {
+            veb_order(root, levels - top, order);
+        }
+    }
+
+    // Moves node order[p] to index p, remapping all links.
+    void renumber(const std::vector<std::uint32_t> &order)
+    {
+        std::vector<std::uint32_t> new_index(size());
+        for (std::uint32_t p = 0; p < size(); p++)
+            new_index[order[p]] = p;
+        auto remap = [&new_index](std::uint32_t old) { return old == NONE ? NONE : new_index[old]; };
+
+        store_type new_values;
+        new_values.reserve(size());
+        std::vector<std::uint32_t> new_parent(size()), new_first_child(size()), new_next_sibling(size());
+        for (std::uint32_t p = 0; p < size(); p++)
+        {
+            std::uint32_t old = order[p];
+            new_values.push_back(std::move(values_[old]));
+            new_parent[p] = remap(parent[old]);
+            new_first_child[p] = remap(first_child[old]);
+            new_next_sibling[p] = remap(next_sibling[old]);
+        }
+        values_ = std::move(new_values);
+        parent.swap(new_parent);
+        first_child.swap(new_first_child);
+        next_sibling.swap(new_next_sibling);
+    }
+
+public:
+    CompactTree() : layout(CompactLayout::BreadthFirst) {}
+
+    // Copies the tree, numbering the nodes in the given layout order.
+    template <typename Aggregate>
+    explicit CompactTree(const Tree<T, K, Aggregate> &tree, CompactLayout node_layout = CompactLayout::BreadthFirst)
+        : layout(node_layout)
+    {
+        using node_type = typename Tree<T, K, Aggregate>::node_type;
+        struct Pending
+        {
+            const node_type *node;
+            std::uint32_t parent;
+        };
+
+        if (tree.getRoot() == nullptr)
+            return;
+
+        // The BFS layout pops pending nodes FIFO from the front, the DFS layout LIFO from the back.
+        // The vEB layout is built in BFS order first and renumbered at the end.
+        std::deque<Pending> pending;
+        std::vector<std::uint32_t> last_child; // last numbered child of each node, to link siblings
+        pending.push_back(Pending{tree.getRoot(), NONE});
+        while (!pending.empty())
+        {
+            Pending next;
+            if (layout != CompactLayout::DepthFirst)
+            {
+                next = pending.front();
+                pending.pop_front();
+            }
+            else
+            {
+                next = pending.back();
+                pending.pop_back();
+            }
+            if (values_.size() >= NONE)
+            {
+                throw std::length_error("Tree is too large for 32-bit node indices.");
+            }
+            std::uint32_t index = (std::uint32_t)values_.size();
+            values_.push_back(next.node->get_value());
+            parent.push_back(next.parent);
+            first_child.push_back(NONE);
+            next_sibling.push_back(NONE);
+            last_child.push_back(NONE);
+            if (next.parent != NONE)
+            {
+                if (last_child[next.parent] == NONE)
+                    first_child[next.parent] = index;
+                else
+                    next_sibling[last_child[next.parent]] = index;
+                last_child[next.parent] = index;
+            }
+
+            auto children = next.node->get_children();
+            if (layout != CompactLayout::DepthFirst)
+            {
+                for (std::size_t i = 0; i < children.size(); i++)
+                    pending.push_back(Pending{children[i], index});
+            }
+            else
+            {
+                for (std::size_t i = children.size(); i-- > 0;)
+                    pending.push_back(Pending{children[i], index});
+            }
+        }
+
+        if (layout == CompactLayout::VanEmdeBoas)
+        {
+            std::vector<std::uint32_t> order;
+            order.reserve(size());
+            veb_order(0, height(), order);
+            renumber(order);
+        }
+    }
+
+    // Number of levels (a single root has height 1).
+    std::uint32_t height() const
+    {
+        if (empty())
+            return 0;
+        std::vector<std::uint32_t> depth(size(), 1);
+        std::uint32_t result = 1;
+        for (std::uint32_t i = 0; i < size(); i++)
+        {
+            for (std::uint32_t child = first_child[i]; child != NONE; child = next_sibling[child])
+            {
+                depth[child] = depth[i] + 1;
+                result = std::max(result, depth[child]);
+            }
+        }
+        return result;
+    }
+
+    std::uint32_t size() const { return (std::uint32_t)values_.size(); }
+    bool empty() const { return values_.empty(); }
+    int get_k() const { return K; }
+    CompactLayout get_layout() const { return layout; }
+
+    const store_type &values() const { return values_; }
+    const_reference value(std::uint32_t node) const { return values_[node]; }
+
+    /*
+    * Calls update(store) on the value store, so bulk kernels (e.g. ComplexArray's *=) rewrite the values
+    * in place. The node numbering stays, so element i is still node i; the store must keep its size.
+    */
+    template <typename Update>
+    void update_values(Update update)
+    {
+        std::size_t before = values_.size();
+        update(values_);
+        if (values_.size() != before)
+            throw std::length_error("update_values must not change the number of values.");
+    }
+    std::uint32_t get_parent(std::uint32_t node) const { return parent[node]; }
+    std::uint32_t get_first_child(std::uint32_t node) const { return first_child[node]; }
+    std::uint32_t get_next_sibling(std::uint32_t node) const { return next_sibling[node]; }
+
+    // Index of the first node (in layout order) holding value, or NONE. A linear scan over values().
+    std::uint32_t find(const T &value) const
+    {
+        for (std::uint32_t i = 0; i < size(); i++)
+        {
+            if (values_[i] == value)
+                return i;
+        }
+        return NONE;
+    }
+
+    /*
+    * Traversals, with the same begin/end pairs and semantics as Tree
+    * (real post-order and generalized in-order for any K).
+    */
+    Iterator begin_pre_order() const { return Iterator(this, Traversal::PreOrder); }
+    Iterator end_pre_order() const { return Iterator(); }
+
+    Iterator begin_post_order() const { return Iterator(this, Traversal::PostOrder); }
+    Iterator end_post_order() const { return Iterator(); }
+
+    Iterator begin_in_order() const { return Iterator(this, Traversal::InOrder); }
+    Iterator end_in_order() const { return Iterator(); }
+
+    Iterator begin_bfs_scan() const { return Iterator(this, Traversal::BreadthFirst); }
+    Iterator end_bfs_scan() const { return Iterator(); }
+
+    Iterator begin_dfs_scan() const { return Iterator(this, Traversal::PreOrder); }
+    Iterator end_dfs_scan() const { return Iterator(); }
+};
+
+/*
+    freeze: takes an immutable snapshot of tree for read-heavy use.
+    The nodes are laid out contiguously in BFS order (children adjacent), DFS order (subtrees contiguous)
+    or van Emde Boas order (cache-oblivious root-to-leaf paths), so traversing the snapshot is a memory
+    sweep instead of pointer chasing.
+*/
+template <typename T, int K, typename Aggregate>
+CompactTree<T, K> freeze(const Tree<T, K, Aggregate> &tree, CompactLayout layout = CompactLayout::BreadthFirst)
+{
+    return CompactTree<T, K>(tree, layout);
+}
+
+#endif // COMPACT_TREE_HPP
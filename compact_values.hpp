@@ -0,0 +1,18 @@
+#ifndef COMPACT_VALUES_HPP
+#define COMPACT_VALUES_HPP
+
+#include <vector>
+
+/*
+    CompactValues<T>: the container a CompactTree<T> keeps its node values in, element i being the value of
+    node i. The store needs size(), empty(), reserve(n), push_back(value) and operator[]; operator[] may
+    return the value itself rather than a reference.
+    Specialize it next to a value type that has a better bulk layout (see complex_array.hpp).
+*/
+template <typename T>
+struct CompactValues
+{
+    using type = std::vector<T>;
+};
+
+#endif // COMPACT_VALUES_HPP
@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstddef>
+#include <functional>
+#include "order_key.hpp"
 
 /*
     Complex class that represents a complex number.
@@ -17,6 +20,8 @@ class Complex{
         double get_real() const { return real; }
         double get_imag() const { return img; }
         double magnitude() const { return sqrt(real * real + img * img); }
+        // Orders like magnitude() without the square root.
+        double magnitude_squared() const { return real * real + img * img; }
         
         Complex operator+(const Complex &c) const {
             return Complex(real + c.real, img + c.img);
@@ -76,20 +81,46 @@ class Complex{
         }
 
         bool operator<(const Complex &c) const {
-            return magnitude() < c.magnitude();
+            return magnitude_squared() < c.magnitude_squared();
         }
 
         bool operator<=(const Complex &c) const {
-            return magnitude() <= c.magnitude();
+            return magnitude_squared() <= c.magnitude_squared();
         }
 
         bool operator>(const Complex &c) const {
-            return magnitude() > c.magnitude();
+            return magnitude_squared() > c.magnitude_squared();
         }
 
         bool operator>=(const Complex &c) const {
-            return magnitude() >= c.magnitude();
+            return magnitude_squared() >= c.magnitude_squared();
         }
 };
 
+/*
+    Ordered tree operations on Complex values sort by the squared magnitude, computed once per node.
+*/
+template <>
+struct OrderKey<Complex>
+{
+    static constexpr bool cached = true;
+    using type = double;
+    static type of(const Complex &value) { return value.magnitude_squared(); }
+    static bool less(type a, type b) { return a < b; }
+};
+
+/*
+    Hash for Complex, so complex values can be keyed in hash containers (e.g. the tree's value index).
+    Consistent with operator==.
+*/
+namespace std {
+    template <>
+    struct hash<Complex> {
+        size_t operator()(const Complex &c) const {
+            size_t h = hash<double>()(c.get_real());
+            return h ^ (hash<double>()(c.get_imag()) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+        }
+    };
+}
+
 #endif
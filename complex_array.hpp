@@ -0,0 +1,252 @@
+#ifndef COMPLEX_ARRAY_HPP
+#define COMPLEX_ARRAY_HPP
+
+#include "complex.hpp"
+#include "compact_values.hpp"
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+/*
+    Packed double arithmetic for the ComplexArray kernels, at the widest width the target was compiled for:
+    AVX2 (4 doubles, build with -mavx2 or -march=native), SSE2 (2 doubles, the x86-64 baseline), or plain
+    scalar code on other targets. The kernels run whole packs, then finish the tail one value at a time.
+*/
+namespace complex_simd
+{
+    // Scalar versions, used for the tails (and for everything on targets without SIMD).
+    inline double add(double a, double b) { return a + b; }
+    inline double sub(double a, double b) { return a - b; }
+    inline double mul(double a, double b) { return a * b; }
+    inline double div(double a, double b) { return a / b; }
+    inline double sqrt(double a) { return std::sqrt(a); }
+
+#if defined(__AVX2__)
+    using pack = __m256d;
+    constexpr std::size_t WIDTH = 4;
+    inline pack load(const double *p) { return _mm256_loadu_pd(p); }
+    inline void store(double *p, pack v) { _mm256_storeu_pd(p, v); }
+    inline pack add(pack a, pack b) { return _mm256_add_pd(a, b); }
+    inline pack sub(pack a, pack b) { return _mm256_sub_pd(a, b); }
+    inline pack mul(pack a, pack b) { return _mm256_mul_pd(a, b); }
+    inline pack div(pack a, pack b) { return _mm256_div_pd(a, b); }
+    inline pack sqrt(pack a) { return _mm256_sqrt_pd(a); }
+#elif defined(__SSE2__) || defined(_M_X64)
+    using pack = __m128d;
+    constexpr std::size_t WIDTH = 2;
+    inline pack load(const double *p) { return _mm_loadu_pd(p); }
+    inline void store(double *p, pack v) { _mm_storeu_pd(p, v); }
+    inline pack add(pack a, pack b) { return _mm_add_pd(a, b); }
+    inline pack sub(pack a, pack b) { return _mm_sub_pd(a, b); }
+    inline pack mul(pack a, pack b) { return _mm_mul_pd(a, b); }
+    inline pack div(pack a, pack b) { return _mm_div_pd(a, b); }
+    inline pack sqrt(pack a) { return _mm_sqrt_pd(a); }
+#else
+    using pack = double;
+    constexpr std::size_t WIDTH = 1;
+    inline pack load(const double *p) { return *p; }
+    inline void store(double *p, pack v) { *p = v; }
+#endif
+
+    /*
+    * Element-wise kernel over n complex numbers: op(ar, ai, br, bi, out_r, out_i) computes one result
+    * from packs, or from single doubles for the tail - the op is a generic lambda used for both.
+    */
+    template <typename Op>
+    void binary(const double *ar, const double *ai, const double *br, const double *bi,
+                double *out_r, double *out_i, std::size_t n, Op op)
+    {
+        std::size_t i = 0;
+        for (; i + WIDTH <= n; i += WIDTH)
+        {
+            pack r, im;
+            op(load(ar + i), load(ai + i), load(br + i), load(bi + i), r, im);
+            store(out_r + i, r);
+            store(out_i + i, im);
+        }
+        for (; i < n; i++)
+        {
+            op(ar[i], ai[i], br[i], bi[i], out_r[i], out_i[i]);
+        }
+    }
+}
+
+/*
+    ComplexArray: a structure-of-arrays store of complex numbers, with the real and the imaginary parts in
+    two separate contiguous buffers, and element-wise kernels that run at SIMD width (see complex_simd).
+    Results match Complex's scalar operators.
+
+    It is the value store of a CompactTree<Complex> (see CompactValues below): compact.values() runs the
+    kernels over the frozen tree's values without a copy, and compact.update_values() rewrites them in place.
+*/
+class ComplexArray
+{
+private:
+    std::vector<double> real_;
+    std::vector<double> imag_;
+
+    // this = op(this, other), element by element; the kernel reads each pack before it writes it back.
+    template <typename Op>
+    void apply(const ComplexArray &other, Op op)
+    {
+        if (other.size() != size())
+            throw std::invalid_argument("ComplexArray sizes do not match.");
+        complex_simd::binary(real_.data(), imag_.data(), other.real_.data(), other.imag_.data(),
+                             real_.data(), imag_.data(), size(), op);
+    }
+
+public:
+    ComplexArray() {}
+
+    explicit ComplexArray(std::size_t n) : real_(n, 0.0), imag_(n, 0.0) {}
+
+    explicit ComplexArray(const std::vector<Complex> &values)
+    {
+        reserve(values.size());
+        for (const auto &value : values)
+        {
+            push_back(value);
+        }
+    }
+
+    std::size_t size() const { return real_.size(); }
+    bool empty() const { return real_.empty(); }
+
+    void reserve(std::size_t n)
+    {
+        real_.reserve(n);
+        imag_.reserve(n);
+    }
+
+    void push_back(const Complex &value)
+    {
+        real_.push_back(value.get_real());
+        imag_.push_back(value.get_imag());
+    }
+
+    Complex operator[](std::size_t i) const { return Complex(real_[i], imag_[i]); }
+
+    void set(std::size_t i, const Complex &value)
+    {
+        real_[i] = value.get_real();
+        imag_[i] = value.get_imag();
+    }
+
+    const double *real() const { return real_.data(); }
+    const double *imag() const { return imag_.data(); }
+
+    std::vector<Complex> to_vector() const
+    {
+        std::vector<Complex> result;
+        result.reserve(size());
+        for (std::size_t i = 0; i < size(); i++)
+        {
+            result.push_back((*this)[i]);
+        }
+        return result;
+    }
+
+    /*
+    * Element-wise arithmetic. The compound forms write into this array's buffers without allocating;
+    * the binary operators copy, then apply the compound form.
+    */
+    ComplexArray &operator+=(const ComplexArray &other)
+    {
+        apply(other, [](auto a, auto b, auto c, auto d, auto &r, auto &i) {
+            using namespace complex_simd;
+            r = add(a, c);
+            i = add(b, d);
+        });
+        return *this;
+    }
+
+    ComplexArray &operator-=(const ComplexArray &other)
+    {
+        apply(other, [](auto a, auto b, auto c, auto d, auto &r, auto &i) {
+            using namespace complex_simd;
+            r = sub(a, c);
+            i = sub(b, d);
+        });
+        return *this;
+    }
+
+    // (a + bi)(c + di) = (ac - bd) + (ad + bc)i
+    ComplexArray &operator*=(const ComplexArray &other)
+    {
+        apply(other, [](auto a, auto b, auto c, auto d, auto &r, auto &i) {
+            using namespace complex_simd;
+            r = sub(mul(a, c), mul(b, d));
+            i = add(mul(a, d), mul(b, c));
+        });
+        return *this;
+    }
+
+    // (a + bi) / (c + di) = ((ac + bd) + (bc - ad)i) / (c^2 + d^2)
+    ComplexArray &operator/=(const ComplexArray &other)
+    {
+        apply(other, [](auto a, auto b, auto c, auto d, auto &r, auto &i) {
+            using namespace complex_simd;
+            auto denominator = add(mul(c, c), mul(d, d));
+            r = div(add(mul(a, c), mul(b, d)), denominator);
+            i = div(sub(mul(b, c), mul(a, d)), denominator);
+        });
+        return *this;
+    }
+
+    ComplexArray operator+(const ComplexArray &other) const { return ComplexArray(*this) += other; }
+    ComplexArray operator-(const ComplexArray &other) const { return ComplexArray(*this) -= other; }
+    ComplexArray operator*(const ComplexArray &other) const { return ComplexArray(*this) *= other; }
+    ComplexArray operator/(const ComplexArray &other) const { return ComplexArray(*this) /= other; }
+
+    // out[i] = real^2 + imag^2: orders like magnitude(), without the square root.
+    void magnitude_squared(std::vector<double> &out) const
+    {
+        norm_kernel(out, false);
+    }
+
+    void magnitude(std::vector<double> &out) const
+    {
+        norm_kernel(out, true);
+    }
+
+private:
+    void norm_kernel(std::vector<double> &out, bool root) const
+    {
+        using namespace complex_simd;
+        out.resize(size());
+        const double *re = real_.data();
+        const double *im = imag_.data();
+        std::size_t i = 0;
+        for (; i + WIDTH <= size(); i += WIDTH)
+        {
+            pack r = load(re + i);
+            pack m = load(im + i);
+            pack norm = add(mul(r, r), mul(m, m));
+            store(out.data() + i, root ? complex_simd::sqrt(norm) : norm);
+        }
+        for (; i < size(); i++)
+        {
+            double norm = re[i] * re[i] + im[i] * im[i];
+            out[i] = root ? std::sqrt(norm) : norm;
+        }
+    }
+};
+
+/*
+    A CompactTree<Complex> keeps its values in a ComplexArray, so bulk operations over a frozen tree run at
+    SIMD width. value(i) and the iterators hand out Complex copies built from the two arrays.
+*/
+template <>
+struct CompactValues<Complex>
+{
+    using type = ComplexArray;
+};
+
+#endif // COMPLEX_ARRAY_HPP
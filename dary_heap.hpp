@@ -0,0 +1,217 @@
+#ifndef DARY_HEAP_HPP
+#define DARY_HEAP_HPP
+
+#include "implicit_index.hpp"
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+    DaryHeap: a mutable K-ary priority queue over contiguous storage.
+    The values form a complete K-ary tree in BFS order (ImplicitIndex<K> arithmetic), so values() can be
+    handed to ImplicitTree<T, K> as is. top() is the first value in Compare order (the smallest by default).
+    push and pop cost O(log_K n) sift steps; a larger K means a shallower tree and fewer cache lines per
+    sift, at the price of up to K comparisons per level on the way down.
+
+    push returns a Handle that follows its value as it moves, for decrease_key (and the general update).
+    A handle stays valid until its value is popped. Its id may then be reused by a later push, but every
+    reuse bumps the id's generation, so a stale handle is rejected instead of reaching the new value.
+*/
+template <typename T, int K = 4, typename Compare = std::less<T>>
+class DaryHeap
+{
+public:
+    class Handle
+    {
+    private:
+        std::size_t id;
+        std::size_t generation;
+        Handle(std::size_t i, std::size_t g) : id(i), generation(g) {}
+        friend class DaryHeap;
+
+    public:
+        Handle() : id(NONE), generation(0) {}
+
+        bool operator==(const Handle &other) const { return id == other.id && generation == other.generation; }
+        bool operator!=(const Handle &other) const { return !(*this == other); }
+    };
+
+private:
+    using implicit = ImplicitIndex<K>;
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    std::vector<T> values_;             // heap order
+    std::vector<std::size_t> ids;       // ids[i]: handle id of values_[i]
+    std::vector<std::size_t> positions; // positions[id]: index of the value in values_, or NONE
+    std::vector<std::size_t> generations; // generations[id]: bumped each time the id is freed
+    std::vector<std::size_t> free_ids;
+    Compare comp;
+
+    void place(std::size_t i, T &&value, std::size_t id)
+    {
+        values_[i] = std::move(value);
+        ids[i] = id;
+        positions[id] = i;
+    }
+
+    // Moves the value at i up while it comes before its parent; the hole travels instead of swapping.
+    void sift_up(std::size_t i)
+    {
+        T value = std::move(values_[i]);
+        std::size_t id = ids[i];
+        while (i > 0)
+        {
+            std::size_t up = implicit::parent(i);
+            if (!comp(value, values_[up]))
+                break;
+            place(i, std::move(values_[up]), ids[up]);
+            i = up;
+        }
+        place(i, std::move(value), id);
+    }
+
+    void sift_down(std::size_t i)
+    {
+        std::size_t n = values_.size();
+        T value = std::move(values_[i]);
+        std::size_t id = ids[i];
+        while (true)
+        {
+            std::size_t first = implicit::first_child(i);
+            if (first >= n)
+                break;
+            std::size_t last = first + K < n ? first + K : n;
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < last; c++)
+            {
+                if (comp(values_[c], values_[best]))
+                    best = c;
+            }
+            if (!comp(values_[best], value))
+                break;
+            place(i, std::move(values_[best]), ids[best]);
+            i = best;
+        }
+        place(i, std::move(value), id);
+    }
+
+    std::size_t position(Handle handle) const
+    {
+        if (!contains(handle))
+            throw std::invalid_argument("Handle is not in the heap (popped, or from another heap).");
+        return positions[handle.id];
+    }
+
+public:
+    explicit DaryHeap(Compare compare = Compare()) : comp(compare) {}
+
+    std::size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    int get_k() const { return K; }
+
+    void reserve(std::size_t n)
+    {
+        values_.reserve(n);
+        ids.reserve(n);
+        positions.reserve(n);
+        generations.reserve(n);
+    }
+
+    // The values in heap (BFS) order.
+    const std::vector<T> &values() const { return values_; }
+
+    bool contains(Handle handle) const
+    {
+        return handle.id < positions.size() && positions[handle.id] != NONE && generations[handle.id] == handle.generation;
+    }
+
+    const T &get(Handle handle) const { return values_[position(handle)]; }
+
+    const T &top() const
+    {
+        if (values_.empty())
+            throw std::out_of_range("Heap is empty.");
+        return values_.front();
+    }
+
+    Handle push(T value)
+    {
+        std::size_t id;
+        if (free_ids.empty())
+        {
+            id = positions.size();
+            positions.push_back(NONE);
+            generations.push_back(0);
+        }
+        else
+        {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+        values_.push_back(std::move(value));
+        ids.push_back(id);
+        sift_up(values_.size() - 1);
+        return Handle(id, generations[id]);
+    }
+
+    // Removes and returns the top value.
+    T pop()
+    {
+        if (values_.empty())
+            throw std::out_of_range("Heap is empty.");
+        T result = std::move(values_.front());
+        positions[ids.front()] = NONE;
+        generations[ids.front()]++;
+        free_ids.push_back(ids.front());
+        std::size_t last = values_.size() - 1;
+        if (last > 0)
+        {
+            place(0, std::move(values_[last]), ids[last]);
+        }
+        values_.pop_back();
+        ids.pop_back();
+        if (!values_.empty())
+            sift_down(0);
+        return result;
+    }
+
+    // Gives the value of handle a key that comes earlier in Compare order (or is equal): O(log_K n).
+    void decrease_key(Handle handle, T value)
+    {
+        std::size_t i = position(handle);
+        if (comp(values_[i], value))
+            throw std::invalid_argument("The new key comes after the current one.");
+        values_[i] = std::move(value);
+        sift_up(i);
+    }
+
+    // Replaces the value of handle in either direction.
+    void update(Handle handle, T value)
+    {
+        std::size_t i = position(handle);
+        bool earlier = comp(value, values_[i]);
+        values_[i] = std::move(value);
+        if (earlier)
+            sift_up(i);
+        else
+            sift_down(i);
+    }
+
+    // Empties the heap; the handles of the removed values become stale, like after pop.
+    void clear()
+    {
+        for (std::size_t id : ids)
+        {
+            positions[id] = NONE;
+            generations[id]++;
+            free_ids.push_back(id);
+        }
+        values_.clear();
+        ids.clear();
+    }
+};
+
+#endif // DARY_HEAP_HPP
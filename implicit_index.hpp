@@ -0,0 +1,29 @@
+#ifndef IMPLICIT_INDEX_HPP
+#define IMPLICIT_INDEX_HPP
+
+#include <cstddef>
+
+/*
+    Index arithmetic of complete K-ary trees stored in BFS order (root at 0).
+    The children of node i are K*i+1 .. K*i+K, its parent is (i-1)/K.
+*/
+template <int K>
+struct ImplicitIndex
+{
+    static_assert(K >= 1, "A tree must allow at least one child per node.");
+
+    static std::size_t parent(std::size_t i) { return (i - 1) / K; }
+    static std::size_t first_child(std::size_t i) { return K * i + 1; }
+    static std::size_t child(std::size_t i, std::size_t j) { return K * i + 1 + j; }
+    static bool is_last_child(std::size_t i) { return (i - 1) % K == K - 1; }
+
+    // First node `levels` levels below i (K^levels * i + K^(levels-1) + ... + 1).
+    static std::size_t first_descendant(std::size_t i, int levels)
+    {
+        for (int l = 0; l < levels; l++)
+            i = first_child(i);
+        return i;
+    }
+};
+
+#endif // IMPLICIT_INDEX_HPP
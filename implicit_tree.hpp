@@ -0,0 +1,287 @@
+#ifndef IMPLICIT_TREE_HPP
+#define IMPLICIT_TREE_HPP
+
+#include "tree.hpp"
+#include "implicit_index.hpp"
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+    ImplicitTree: pointer-free storage for complete K-ary trees (every level full except the last,
+    which is filled from the left), such as heaps.
+    Only the values are stored, in BFS order; the topology is pure index arithmetic (ImplicitIndex).
+    A BFS scan is a sequential sweep and the depth-first traversals need neither pointers nor a stack.
+
+    For binary trees, from_sorted() builds the Eytzinger (BFS order binary search tree) layout and
+    lower_bound() searches it, prefetching a few levels ahead.
+*/
+template <typename T, int K = 2>
+class ImplicitTree
+{
+public:
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+    static constexpr int PREFETCH_LEVELS = K <= 2 ? 4 : (K <= 4 ? 2 : 1); // about one cache line of descendants ahead
+
+    enum class Traversal
+    {
+        PreOrder,
+        InOrder,
+        PostOrder,
+        BreadthFirst
+    };
+
+    class Iterator
+    {
+    private:
+        using implicit = ImplicitIndex<K>;
+
+        const ImplicitTree *tree;
+        std::size_t node;
+        Traversal order;
+
+        bool exists(std::size_t i) const { return i < tree->size(); }
+
+        bool has_next_sibling(std::size_t i) const { return i != 0 && !implicit::is_last_child(i) && exists(i + 1); }
+
+        std::size_t leftmost(std::size_t i) const
+        {
+            while (exists(implicit::first_child(i)))
+                i = implicit::first_child(i);
+            return i;
+        }
+
+        void next_pre_order()
+        {
+            if (exists(implicit::first_child(node)))
+            {
+                node = implicit::first_child(node);
+                return;
+            }
+            while (node != 0 && !has_next_sibling(node))
+                node = implicit::parent(node);
+            node = node == 0 ? NONE : node + 1;
+        }
+
+        void next_post_order()
+        {
+            if (node == 0)
+                node = NONE;
+            else if (has_next_sibling(node))
+                node = leftmost(node + 1);
+            else
+                node = implicit::parent(node);
+        }
+
+        // First child's subtree, the node, the remaining children's subtrees.
+        void next_in_order()
+        {
+            std::size_t second = implicit::child(node, 1);
+            if (K > 1 && exists(second))
+            {
+                node = leftmost(second);
+                return;
+            }
+            std::size_t done = node;
+            while (done != 0)
+            {
+                std::size_t up = implicit::parent(done);
+                if (done == implicit::first_child(up))
+                {
+                    node = up;
+                    return;
+                }
+                if (has_next_sibling(done))
+                {
+                    node = leftmost(done + 1);
+                    return;
+                }
+                done = up;
+            }
+            node = NONE;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        Iterator() : tree(nullptr), node(NONE), order(Traversal::PreOrder) {}
+
+        Iterator(const ImplicitTree *t, Traversal traversal_order) : tree(t), node(NONE), order(traversal_order)
+        {
+            if (tree->size() == 0)
+                return;
+            node = (order == Traversal::InOrder || order == Traversal::PostOrder) ? leftmost(0) : 0;
+        }
+
+        std::size_t index() const { return node; }
+
+        reference operator*() const { return tree->values_[node]; }
+        pointer operator->() const { return &tree->values_[node]; }
+
+        Iterator &operator++()
+        {
+            switch (order)
+            {
+            case Traversal::PreOrder:
+                next_pre_order();
+                break;
+            case Traversal::InOrder:
+                next_in_order();
+                break;
+            case Traversal::PostOrder:
+                next_post_order();
+                break;
+            case Traversal::BreadthFirst:
+                node = node + 1 < tree->size() ? node + 1 : NONE;
+                break;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator &other) const { return node == other.node; }
+        bool operator!=(const Iterator &other) const { return node != other.node; }
+    };
+
+private:
+    std::vector<T> values_;
+
+    void fill_in_order(const std::vector<T> &sorted, std::size_t &next, std::size_t i)
+    {
+        if (i >= values_.size())
+            return;
+        fill_in_order(sorted, next, ImplicitIndex<K>::child(i, 0));
+        values_[i] = sorted[next++];
+        fill_in_order(sorted, next, ImplicitIndex<K>::child(i, 1));
+    }
+
+public:
+    ImplicitTree() {}
+
+    // Takes values already in BFS order (e.g. a heap array).
+    explicit ImplicitTree(std::vector<T> bfs_values) : values_(std::move(bfs_values)) {}
+
+    // Copies a complete tree. Throws std::invalid_argument when the tree is not complete.
+    template <typename Aggregate>
+    explicit ImplicitTree(const Tree<T, K, Aggregate> &tree)
+    {
+        using node_type = typename Tree<T, K, Aggregate>::node_type;
+        if (tree.getRoot() == nullptr)
+            return;
+
+        std::vector<const node_type *> queue;
+        queue.push_back(tree.getRoot());
+        for (std::size_t i = 0; i < queue.size(); i++)
+        {
+            auto children = queue[i]->get_children();
+            if (!children.empty() && queue.size() != ImplicitIndex<K>::first_child(i))
+            {
+                throw std::invalid_argument("Tree is not complete, it has no implicit layout.");
+            }
+            for (auto child : children)
+            {
+                queue.push_back(child);
+            }
+        }
+        values_.reserve(queue.size());
+        for (auto node : queue)
+        {
+            values_.push_back(node->get_value());
+        }
+    }
+
+    // Eytzinger layout of sorted values: a complete binary search tree whose in-order is the input.
+    static ImplicitTree from_sorted(const std::vector<T> &sorted)
+    {
+        static_assert(K == 2, "The Eytzinger layout is a binary search tree.");
+        ImplicitTree result;
+        result.values_ = sorted;
+        std::size_t next = 0;
+        result.fill_in_order(sorted, next, 0);
+        return result;
+    }
+
+    std::size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    int get_k() const { return K; }
+
+    const std::vector<T> &values() const { return values_; }
+    const T &value(std::size_t node) const { return values_[node]; }
+
+    // Index of the first node in BFS order holding value, or NONE.
+    std::size_t find(const T &value) const
+    {
+        for (std::size_t i = 0; i < values_.size(); i++)
+        {
+            if (values_[i] == value)
+                return i;
+        }
+        return NONE;
+    }
+
+    /*
+    * Eytzinger search (trees built by from_sorted): index of the smallest value not less than value, or NONE.
+    * While comparing at node i it prefetches the first descendant PREFETCH_LEVELS levels below,
+    * whose cache line holds the whole group of candidates the search can reach there.
+    */
+    std::size_t lower_bound(const T &value) const
+    {
+        static_assert(K == 2, "lower_bound needs the binary Eytzinger layout.");
+        const T *data = values_.data();
+        std::size_t n = values_.size();
+        std::size_t best = NONE;
+        std::size_t i = 0;
+        while (i < n)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            std::size_t ahead = ImplicitIndex<K>::first_descendant(i, PREFETCH_LEVELS);
+            if (ahead < n)
+                __builtin_prefetch(data + ahead);
+#endif
+            if (!(data[i] < value))
+            {
+                best = i;
+                i = ImplicitIndex<K>::child(i, 0);
+            }
+            else
+            {
+                i = ImplicitIndex<K>::child(i, 1);
+            }
+        }
+        return best;
+    }
+
+    /*
+    * Traversals, with the same begin/end pairs and semantics as Tree
+    * (real post-order and generalized in-order for any K).
+    */
+    Iterator begin_pre_order() const { return Iterator(this, Traversal::PreOrder); }
+    Iterator end_pre_order() const { return Iterator(); }
+
+    Iterator begin_post_order() const { return Iterator(this, Traversal::PostOrder); }
+    Iterator end_post_order() const { return Iterator(); }
+
+    Iterator begin_in_order() const { return Iterator(this, Traversal::InOrder); }
+    Iterator end_in_order() const { return Iterator(); }
+
+    Iterator begin_bfs_scan() const { return Iterator(this, Traversal::BreadthFirst); }
+    Iterator end_bfs_scan() const { return Iterator(); }
+
+    Iterator begin_dfs_scan() const { return Iterator(this, Traversal::PreOrder); }
+    Iterator end_dfs_scan() const { return Iterator(); }
+};
+
+#endif // IMPLICIT_TREE_HPP
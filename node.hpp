@@ -1,13 +1,62 @@
 #ifndef NODE_HPP
 #define NODE_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
+
 /*
-Node class that represents a node in a tree.
+ChildView class: a non-owning, read-only view over a node's child pointers.
+Iterating it does not copy or allocate. It is invalidated when children are added to the node.
+*/
+template <typename N>
+class ChildView {
+private:
+    N* const* first;
+    std::size_t count;
+
+public:
+    ChildView(N* const* data, std::size_t size) : first(data), count(size) {}
+
+    N* const* begin() const { return first; }
+    N* const* end() const { return first + count; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    N* operator[](std::size_t i) const { return first[i]; }
+};
 
+/*
+Node class that represents a node in a tree.
+K is the maximum number of children:
+    - K = 0 (default): any number of children, kept in a std::vector. This is also the value type callers pass to Tree.
+    - K > 0: fixed fanout, child pointers are stored inline in a std::array (used by Tree<T, K>).
 */
-template <typename T>
+template <typename T, int K = 0>
 class Node {
+public:
+    static_assert(K >= 0, "Node fanout must be non-negative.");
+
+    T value;
+    std::uint32_t count; // number of children in use
+    std::array<Node<T, K>*, K> children;
+
+    Node(T val) : value(val), count(0), children() {}
+
+    T get_value() const { return value; }
+
+    // Attaches an already allocated node. The caller makes sure there is room (child_count() < K).
+    void add_child(Node<T, K>* child) {
+        children[count++] = child;
+    }
+
+    std::size_t child_count() const { return count; }
+
+    ChildView<Node<T, K>> get_children() const { return ChildView<Node<T, K>>(children.data(), count); }
+};
+
+template <typename T>
+class Node<T, 0> {
 public:
     T value;
     std::vector<Node<T>*> children;
@@ -21,7 +70,14 @@ public:
         children.push_back(new Node<T>(child));
     }
 
-    std::vector<Node<T>*> get_children() const { return children; }
+    // Attaches an already allocated node (e.g. one handed out by the tree's NodePool).
+    void add_child(Node<T>* child) {
+        children.push_back(child);
+    }
+
+    std::size_t child_count() const { return children.size(); }
+
+    ChildView<Node<T>> get_children() const { return ChildView<Node<T>>(children.data(), children.size()); }
 };
 
-#endif // NODE_HPP
\ No newline at end of file
+#endif // NODE_HPP
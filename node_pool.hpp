@@ -0,0 +1,131 @@
+#ifndef NODE_POOL_HPP
+#define NODE_POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+    NodePool: a slab allocator for tree nodes.
+    Nodes are handed out from contiguous chunks of ChunkSize slots instead of one heap allocation per node.
+    Destroyed nodes go to a free list and their slots are reused by the next create().
+    Releasing the pool frees the chunks only (O(chunks)), it does not run the nodes' destructors -
+    the owner must destroy non-trivially destructible nodes before that.
+*/
+template <typename N, std::size_t ChunkSize = 1024>
+class NodePool
+{
+private:
+    union Slot
+    {
+        Slot *next;
+        alignas(N) unsigned char storage[sizeof(N)];
+    };
+
+    std::vector<Slot *> chunks;
+    Slot *free_list;
+    std::size_t next_in_chunk; // first never-used slot in the last chunk
+    std::size_t live;
+
+    Slot *take_slot()
+    {
+        if (free_list != nullptr)
+        {
+            Slot *slot = free_list;
+            free_list = slot->next;
+            return slot;
+        }
+        if (chunks.empty() || next_in_chunk == ChunkSize)
+        {
+            chunks.push_back(static_cast<Slot *>(::operator new(sizeof(Slot) * ChunkSize)));
+            next_in_chunk = 0;
+        }
+        return chunks.back() + next_in_chunk++;
+    }
+
+public:
+    NodePool() : free_list(nullptr), next_in_chunk(0), live(0) {}
+    ~NodePool()
+    {
+        release();
+    }
+
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+
+    template <typename... Args>
+    N *create(Args &&...args)
+    {
+        Slot *slot = take_slot();
+        N *node;
+        try
+        {
+            node = ::new (static_cast<void *>(slot->storage)) N(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            if (slot == chunks.back() + next_in_chunk - 1)
+            {
+                next_in_chunk--; // a fresh slot: give it back without leaving a hole in creation order
+            }
+            else
+            {
+                slot->next = free_list;
+                free_list = slot;
+            }
+            throw;
+        }
+        ++live;
+        return node;
+    }
+
+    void destroy(N *node)
+    {
+        if (node == nullptr)
+            return;
+        node->~N();
+        Slot *slot = reinterpret_cast<Slot *>(node);
+        slot->next = free_list;
+        free_list = slot;
+        --live;
+    }
+
+    // Frees every chunk at once. Any node still alive is dropped without its destructor running.
+    void release()
+    {
+        for (Slot *chunk : chunks)
+        {
+            ::operator delete(chunk);
+        }
+        chunks.clear();
+        free_list = nullptr;
+        next_in_chunk = 0;
+        live = 0;
+    }
+
+    /*
+    * First node in creation order (chunk by chunk, slot by slot) for which pred is true, or nullptr.
+    * Only valid while no node has been destroyed: freed and reused slots would break the order.
+    */
+    template <typename Pred>
+    N *find_if(Pred pred) const
+    {
+        for (std::size_t c = 0; c < chunks.size(); c++)
+        {
+            std::size_t used = c + 1 == chunks.size() ? next_in_chunk : ChunkSize;
+            for (std::size_t i = 0; i < used; i++)
+            {
+                N *node = std::launder(reinterpret_cast<N *>(chunks[c][i].storage));
+                if (pred(node))
+                    return node;
+            }
+        }
+        return nullptr;
+    }
+
+    std::size_t size() const { return live; }
+    std::size_t chunk_count() const { return chunks.size(); }
+};
+
+#endif // NODE_POOL_HPP
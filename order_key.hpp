@@ -0,0 +1,32 @@
+#ifndef ORDER_KEY_HPP
+#define ORDER_KEY_HPP
+
+#include <type_traits>
+
+/*
+    OrderKey<T>: the comparable key the ordered tree operations (heap, top_k, kth) extract once per node,
+    so sorting and heap sifts compare compact keys instead of calling operator< on the values over and over.
+    - type: the key, of(value) extracts it, less(a, b) orders two keys like value_a < value_b.
+    - cached: the key is a small copy of what the ordering needs (arithmetic types, Complex).
+      For other types the key is just a pointer to the value and less compares the values themselves.
+    Specialize it next to a value type whose operator< is expensive (see complex.hpp).
+*/
+template <typename T, typename = void>
+struct OrderKey
+{
+    static constexpr bool cached = false;
+    using type = const T *;
+    static type of(const T &value) { return &value; }
+    static bool less(type a, type b) { return *a < *b; }
+};
+
+template <typename T>
+struct OrderKey<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static constexpr bool cached = true;
+    using type = T;
+    static type of(const T &value) { return value; }
+    static bool less(type a, type b) { return a < b; }
+};
+
+#endif // ORDER_KEY_HPP
@@ -2,8 +2,18 @@
 #include "complex.hpp"
 #include "node.hpp"
 #include "tree.hpp"
+#include "node_pool.hpp"
+#include "compact_tree.hpp"
+#include "implicit_tree.hpp"
+#include "thread_pool.hpp"
+#include "dary_heap.hpp"
+#include "complex_array.hpp"
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <algorithm>
 
 /*
     Test Cases:
@@ -21,9 +31,74 @@
     - 3-ary tree DFS traversal
     - 3-ary DFS traversal
     - Heap Traversal
+
+    - Node pool: slot reuse and chunk growth
+    - Node pool: tree of non-trivial values
+    - Child view: no copies of the children
+    - Traversals do not allocate per visited node
+    - Lazy traversals: early stop and iterator copies
+    - Value index: duplicate values attach to the first inserted node
+    - Value index: unhashable values fall back to search
+    - Value index: built by the first lookup by value
+    - Node handles: insertion below a handle
+    - Node handles: invalid, foreign and full parents
+    - Fixed-fanout nodes: inline children
+    - Compact tree: same traversals as the pointer tree
+    - Compact tree: traversals do not allocate
+    - Compact tree: BFS numbering and links
+    - Freeze: BFS and DFS layouts
+    - Freeze: van Emde Boas layout
+    - Implicit tree: traversals by index arithmetic
+    - Implicit tree: Eytzinger search
+    - Traversal cache: reuse until the tree changes
+    - Const traversals: nested loops and concurrent readers
+    - Deep chains: no recursion in the helpers
+    - Morris traversals: same order, structure restored
+    - Parallel BFS: same order as the sequential scan
+    - Parallel reduce: sums, maxima and counts match the sequential fold
+    - K-ary traversals: post-order and generalized in-order
+    - Heap traversal: ascending order, popped lazily
+    - Selection: top_k and kth with a bounded heap
+    - D-ary heap: push, pop and decrease-key through handles
+    - Complex array: SIMD kernels match the scalar operators
+    - Complex array: value store of a compact Tree<Complex>
+    - Order keys: one key per node for heap and selection
+    - Subtree aggregates: maintained on insertion
 */
 using namespace std;
 
+/*
+    Global allocation counter, used to check that traversals do not allocate.
+    Counting is only active between start_counting_allocations() and stop_counting_allocations().
+*/
+static size_t allocation_count = 0;
+static bool counting_allocations = false;
+
+void *operator new(size_t size)
+{
+    if (counting_allocations)
+        allocation_count++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static void start_counting_allocations()
+{
+    allocation_count = 0;
+    counting_allocations = true;
+}
+
+static size_t stop_counting_allocations()
+{
+    counting_allocations = false;
+    return allocation_count;
+}
+
 TEST_CASE("Invalid tree operation: Adding a 3rd node to a binary tree")
 {
     Node<double> root_node = Node<double>(1.1);
@@ -261,7 +336,7 @@ TEST_CASE("Test myHeap Traversal"){
         ss << (*node)->get_value() << " ";
     }
 
-    CHECK(ss.str() == "1.1 1.2 1.4 1.5 1.3 1.6 ");
+    CHECK(ss.str() == "1.1 1.2 1.3 1.4 1.5 1.6 ");
 }
 
 TEST_CASE("Complex Tree: DFS Traversal"){
@@ -449,3 +524,1159 @@ TEST_CASE("Test > operator"){
     CHECK(!(c1 > c1));
     CHECK(c1 > c4);
 }
+
+TEST_CASE("Node pool: slot reuse and chunk growth"){
+    NodePool<Node<int>, 4> pool;
+    Node<int> *a = pool.create(1);
+    Node<int> *b = pool.create(2);
+    CHECK(pool.size() == 2);
+    CHECK(pool.chunk_count() == 1);
+
+    pool.destroy(a);
+    Node<int> *c = pool.create(3);
+    CHECK(c == a); // freed slot is handed out again
+    CHECK(c->get_value() == 3);
+    CHECK(b->get_value() == 2);
+
+    for (int i = 0; i < 3; i++) {
+        pool.create(i);
+    }
+    CHECK(pool.size() == 5);
+    CHECK(pool.chunk_count() == 2);
+
+    pool.release();
+    CHECK(pool.size() == 0);
+    CHECK(pool.chunk_count() == 0);
+
+    // find_if visits the slots in creation order, across chunks.
+    NodePool<Node<int>, 4> ordered;
+    for (int i = 0; i < 6; i++) {
+        ordered.create(i);
+    }
+    string order;
+    ordered.find_if([&order](Node<int> *node) { order += to_string(node->get_value()); return false; });
+    CHECK(order == "012345");
+    CHECK(ordered.find_if([](Node<int> *node) { return node->get_value() == 4; })->get_value() == 4);
+    CHECK(ordered.find_if([](Node<int> *node) { return node->get_value() == 9; }) == nullptr);
+}
+
+TEST_CASE("Node pool: tree of non-trivial values"){
+    Tree<string, 3> tree;
+    Node<string> root_node = Node<string>("root");
+    tree.add_root(root_node);
+    Node<string> n1 = Node<string>("a long string value that does not fit in SSO");
+    Node<string> n2 = Node<string>("b");
+    tree.add_sub_node(root_node, n1);
+    tree.add_sub_node(root_node, n2);
+    tree.add_sub_node(n1, Node<string>("c"));
+
+    stringstream ss;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        ss << (*node)->get_value() << " ";
+    }
+
+    CHECK(ss.str() == "root a long string value that does not fit in SSO c b ");
+}
+
+TEST_CASE("Child view: no copies of the children"){
+    Tree<int, 3> tree;
+    Node<int> root_node = Node<int>(1);
+    tree.add_root(root_node);
+    tree.add_sub_node(root_node, Node<int>(2));
+    tree.add_sub_node(root_node, Node<int>(3));
+
+    auto *root = tree.getRoot();
+    auto children = root->get_children();
+    CHECK(children.size() == 2);
+    CHECK(!children.empty());
+    CHECK(children[0]->get_value() == 2);
+    CHECK(children[1]->get_value() == 3);
+    CHECK(children.begin() == root->children.data()); // views the node's own storage
+    CHECK(children[0]->get_children().empty());
+}
+
+TEST_CASE("Traversals do not allocate per visited node"){
+    Tree<int> tree;
+    vector<Tree<int>::NodeHandle> handles;
+    handles.push_back(tree.add_root(Node<int>(0)));
+    for (int i = 1; i < 4095; i++) {
+        handles.push_back(tree.add_sub_node(handles[(i - 1) / 2], i));
+    }
+
+    auto run_all = [&tree]() {
+        long sum = 0;
+        for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) sum += (*node)->get_value();
+        for (auto node = tree.begin_post_order(); node != tree.end_post_order(); ++node) sum += (*node)->get_value();
+        for (auto node = tree.begin_in_order(); node != tree.end_in_order(); ++node) sum += (*node)->get_value();
+        for (auto node = tree.begin_bfs_scan(); node != tree.end_bfs_scan(); ++node) sum += (*node)->get_value();
+        for (auto node = tree.begin_dfs_scan(); node != tree.end_dfs_scan(); ++node) sum += (*node)->get_value();
+        for (auto node = tree.begin_heap(); node != tree.end_heap(); ++node) sum += (*node)->get_value();
+        return sum;
+    };
+
+    long expected = run_all(); // warms up the heap cache
+    start_counting_allocations();
+    long sum = run_all();
+    size_t allocations = stop_counting_allocations();
+
+    CHECK(sum == expected);
+    // One stack per depth-first traversal, log2(widest level / 16) growths of the BFS ring buffer,
+    // and log2(leaves) growths of the heap iterator's frontier (the cached heap itself is not copied).
+    CHECK(allocations <= 4 + 8 + 12);
+}
+
+TEST_CASE("Value index: duplicate values attach to the first inserted node"){
+    Tree<int, 3> tree;
+    tree.add_root(Node<int>(1));
+    tree.add_sub_node(Node<int>(1), Node<int>(2));
+    tree.add_sub_node(Node<int>(1), Node<int>(3));
+    tree.add_sub_node(Node<int>(3), Node<int>(2)); // duplicate value under 3
+    tree.add_sub_node(Node<int>(2), Node<int>(4)); // resolves to the first 2
+
+    stringstream ss;
+    for (auto node = tree.begin_bfs_scan(); node != tree.end_bfs_scan(); ++node) {
+        ss << (*node)->get_value() << " ";
+    }
+
+    CHECK(ss.str() == "1 2 3 4 2 ");
+    CHECK(tree.getRoot()->get_children()[0]->get_children().size() == 1);
+    CHECK_THROWS(tree.add_sub_node(Node<int>(7), Node<int>(8)));
+}
+
+struct Point {
+    int x, y;
+    bool operator==(const Point &other) const { return x == other.x && y == other.y; }
+};
+
+TEST_CASE("Value index: unhashable values fall back to search"){
+    static_assert(is_hashable<Complex>::value, "Complex should be indexed");
+    static_assert(!is_hashable<Point>::value, "Point has no std::hash");
+
+    Tree<Point> tree;
+    tree.add_root(Node<Point>(Point{0, 0}));
+    tree.add_sub_node(Node<Point>(Point{0, 0}), Node<Point>(Point{1, 0}));
+    tree.add_sub_node(Node<Point>(Point{1, 0}), Node<Point>(Point{2, 0}));
+
+    CHECK(tree.getRoot()->get_children()[0]->get_children()[0]->get_value().x == 2);
+    CHECK_THROWS(tree.add_sub_node(Node<Point>(Point{5, 5}), Node<Point>(Point{6, 6})));
+}
+
+// Hashing throws while failing is set.
+struct Flaky {
+    int v;
+    static bool failing;
+    bool operator==(const Flaky &other) const { return v == other.v; }
+};
+bool Flaky::failing = false;
+
+namespace std {
+template <>
+struct hash<Flaky> {
+    size_t operator()(const Flaky &f) const
+    {
+        if (Flaky::failing)
+            throw runtime_error("hash");
+        return hash<int>()(f.v);
+    }
+};
+}
+
+TEST_CASE("Value index: built by the first lookup by value"){
+    Tree<string, 3> tree;
+    auto root = tree.add_root(Node<string>("a"));
+    auto b = tree.add_sub_node(root, "b");
+    auto c = tree.add_sub_node(root, "c");
+    tree.add_sub_node(b, "c"); // duplicate: earlier in pre-order, but inserted later
+    tree.add_sub_node(root, "d");
+
+    CHECK(tree.find("c") == c); // the index is built here, in insertion order
+    CHECK(tree.find("x") == Tree<string, 3>::NodeHandle());
+    auto e = tree.add_sub_node(Node<string>("d"), Node<string>("e"));
+    tree.add_sub_node(e, "b"); // duplicate inserted after the index was built
+    CHECK(tree.find("e") == e);
+    CHECK(tree.find("b") == b);
+
+    // The unhashable fallback resolves duplicates the same way.
+    Tree<Point, 3> points;
+    auto origin = points.add_root(Node<Point>(Point{0, 0}));
+    auto first = points.add_sub_node(origin, Point{1, 1});
+    auto left = points.add_sub_node(origin, Point{2, 2});
+    points.add_sub_node(left, Point{1, 1});
+    CHECK(points.find(Point{1, 1}) == first);
+
+    // A failed build leaves no index behind: the next lookup builds it again.
+    Tree<Flaky> flaky;
+    auto top = flaky.add_root(Node<Flaky>(Flaky{1}));
+    flaky.add_sub_node(top, Flaky{2});
+    Flaky::failing = true;
+    CHECK_THROWS_AS(flaky.find(Flaky{2}), runtime_error);
+    Flaky::failing = false;
+    CHECK(flaky.find(Flaky{2}).get_value().v == 2);
+}
+
+TEST_CASE("Node handles: insertion below a handle"){
+    Tree<int, 3> tree;
+    auto root = tree.add_root(Node<int>(1));
+    auto left = tree.add_sub_node(root, 7);
+    auto right = tree.add_sub_node(root, 7); // duplicate values are fine with handles
+    tree.add_sub_node(right, 8);
+    auto mixed = tree.add_sub_node(Node<int>(1), Node<int>(9)); // value-based insertion also returns a handle
+
+    CHECK(root.get_node() == tree.getRoot());
+    CHECK(left != right);
+    CHECK(left.get_value() == 7);
+    CHECK(right.get_node()->get_children()[0]->get_value() == 8);
+    CHECK(left.get_node()->get_children().empty());
+    CHECK(mixed.get_node() == tree.getRoot()->get_children()[2]);
+}
+
+TEST_CASE("Node handles: invalid, foreign and full parents"){
+    Tree<int> tree;
+    auto root = tree.add_root(Node<int>(1));
+    Tree<int>::NodeHandle none;
+
+    CHECK(!none.valid());
+    CHECK_THROWS(tree.add_sub_node(none, 2));
+    {
+        Tree<int> other;
+        CHECK_THROWS(other.add_sub_node(root, 2)); // root belongs to tree
+    }
+    CHECK(tree.getRoot()->get_children().empty());
+    tree.add_sub_node(root, 2);
+    tree.add_sub_node(root, 3);
+    CHECK_THROWS(tree.add_sub_node(root, 4));
+}
+
+TEST_CASE("Lazy traversals: early stop and iterator copies"){
+    Tree<int> tree;
+    auto root = tree.add_root(Node<int>(1));
+    auto left = tree.add_sub_node(root, 2);
+    auto right = tree.add_sub_node(root, 3);
+    tree.add_sub_node(left, 4);
+    tree.add_sub_node(right, 5);
+
+    auto it = tree.begin_post_order();
+    CHECK((*it)->get_value() == 4);
+    auto copy = it++;
+    CHECK((*copy)->get_value() == 4);
+    CHECK((*it)->get_value() == 2);
+    CHECK(copy != it);
+    ++copy;
+    CHECK(copy == it);
+
+    int visited = 0;
+    for (auto node = tree.begin_bfs_scan(); node != tree.end_bfs_scan(); ++node) {
+        if (++visited == 2) break;
+    }
+    CHECK(visited == 2);
+
+    Tree<int> empty;
+    CHECK(empty.begin_pre_order() == empty.end_pre_order());
+    CHECK(empty.begin_bfs_scan() == empty.end_bfs_scan());
+}
+
+TEST_CASE("Fixed-fanout nodes: inline children"){
+    static_assert(is_same<Tree<double>::node_type, Node<double, 2>>::value, "Tree<T, K> uses Node<T, K>");
+    static_assert(sizeof(Node<int, 2>) <= 32, "binary int node fits in half a cache line");
+    static_assert(sizeof(Node<double, 4>) <= 64, "4-ary double node fits in a cache line");
+    static_assert(is_trivially_destructible<Node<double, 3>>::value, "no per-node cleanup for trivial values");
+
+    Tree<double, 3> tree;
+    auto root = tree.add_root(Node<double>(1.5));
+    tree.add_sub_node(root, 2.5);
+    tree.add_sub_node(root, 3.5);
+
+    auto *node = tree.getRoot();
+    CHECK(node->child_count() == 2);
+    CHECK(node->get_children()[1]->get_value() == 3.5);
+    CHECK(node->children[2] == nullptr);
+}
+
+// Complete binary tree holding 0..n-1 in BFS order.
+static void build_complete_int_tree(Tree<int> &tree, int n)
+{
+    vector<Tree<int>::NodeHandle> handles;
+    handles.push_back(tree.add_root(Node<int>(0)));
+    for (int i = 1; i < n; i++) {
+        handles.push_back(tree.add_sub_node(handles[(i - 1) / 2], i));
+    }
+}
+
+// Concatenates the values of a traversal, for comparing traversals of different tree types.
+template <typename It>
+static string values_of(It begin, It end)
+{
+    stringstream ss;
+    for (auto it = begin; it != end; ++it) {
+        ss << *it << " ";
+    }
+    return ss.str();
+}
+
+template <typename It>
+static string node_values_of(It begin, It end)
+{
+    stringstream ss;
+    for (auto it = begin; it != end; ++it) {
+        ss << (*it)->get_value() << " ";
+    }
+    return ss.str();
+}
+
+TEST_CASE("Compact tree: same traversals as the pointer tree"){
+    Tree<int> tree;
+    auto root = tree.add_root(Node<int>(1));
+    auto n2 = tree.add_sub_node(root, 2);
+    auto n3 = tree.add_sub_node(root, 3);
+    auto n4 = tree.add_sub_node(n2, 4);
+    tree.add_sub_node(n2, 5);
+    tree.add_sub_node(n3, 6);
+    tree.add_sub_node(n4, 7);
+
+    CompactTree<int> compact(tree);
+    CHECK(compact.size() == 7);
+    CHECK(values_of(compact.begin_pre_order(), compact.end_pre_order()) == node_values_of(tree.begin_pre_order(), tree.end_pre_order()));
+    CHECK(values_of(compact.begin_post_order(), compact.end_post_order()) == node_values_of(tree.begin_post_order(), tree.end_post_order()));
+    CHECK(values_of(compact.begin_in_order(), compact.end_in_order()) == node_values_of(tree.begin_in_order(), tree.end_in_order()));
+    CHECK(values_of(compact.begin_bfs_scan(), compact.end_bfs_scan()) == node_values_of(tree.begin_bfs_scan(), tree.end_bfs_scan()));
+    CHECK(values_of(compact.begin_dfs_scan(), compact.end_dfs_scan()) == node_values_of(tree.begin_dfs_scan(), tree.end_dfs_scan()));
+    CHECK(values_of(compact.begin_in_order(), compact.end_in_order()) == "7 4 2 5 1 6 3 ");
+
+    Tree<int, 3> three_ary_tree;
+    auto r = three_ary_tree.add_root(Node<int>(1));
+    auto c2 = three_ary_tree.add_sub_node(r, 2);
+    auto c3 = three_ary_tree.add_sub_node(r, 3);
+    three_ary_tree.add_sub_node(r, 4);
+    three_ary_tree.add_sub_node(c2, 5);
+    three_ary_tree.add_sub_node(c3, 6);
+
+    CompactTree<int, 3> compact3(three_ary_tree);
+    CHECK(values_of(compact3.begin_dfs_scan(), compact3.end_dfs_scan()) == "1 2 5 3 6 4 ");
+    CHECK(values_of(compact3.begin_bfs_scan(), compact3.end_bfs_scan()) == "1 2 3 4 5 6 ");
+
+    Tree<int> empty;
+    CompactTree<int> compact_empty(empty);
+    CHECK(compact_empty.empty());
+    CHECK(compact_empty.begin_pre_order() == compact_empty.end_pre_order());
+    CHECK(compact_empty.begin_in_order() == compact_empty.end_in_order());
+}
+
+TEST_CASE("Compact tree: traversals do not allocate"){
+    Tree<int> tree;
+    build_complete_int_tree(tree, 4095);
+    auto bfs = freeze(tree, CompactLayout::BreadthFirst);
+    auto dfs = freeze(tree, CompactLayout::DepthFirst);
+
+    auto run_all = [](const CompactTree<int> &compact, bool with_bfs) {
+        long sum = 0;
+        for (auto it = compact.begin_pre_order(); it != compact.end_pre_order(); ++it) sum += *it;
+        for (auto it = compact.begin_post_order(); it != compact.end_post_order(); ++it) sum += *it;
+        for (auto it = compact.begin_in_order(); it != compact.end_in_order(); ++it) sum += *it;
+        for (auto it = compact.begin_dfs_scan(); it != compact.end_dfs_scan(); ++it) sum += *it;
+        if (with_bfs)
+            for (auto it = compact.begin_bfs_scan(); it != compact.end_bfs_scan(); ++it) sum += *it;
+        return sum;
+    };
+
+    start_counting_allocations();
+    long sum = run_all(bfs, true) + run_all(dfs, false);
+    size_t allocations = stop_counting_allocations();
+    CHECK(sum == 9L * 4094 * 4095 / 2);
+    CHECK(allocations == 0); // the link-walking iterators and the end sentinels hold no buffers
+
+    // A BFS over the depth-first layout needs a queue: it grows to about the widest level, not per step.
+    start_counting_allocations();
+    long bfs_sum = 0;
+    for (auto it = dfs.begin_bfs_scan(); it != dfs.end_bfs_scan(); ++it) bfs_sum += *it;
+    allocations = stop_counting_allocations();
+    CHECK(bfs_sum == 4094L * 4095 / 2);
+    CHECK(allocations <= 16);
+}
+
+TEST_CASE("Compact tree: BFS numbering and links"){
+    Tree<Complex> tree;
+    auto root = tree.add_root(Node<Complex>(Complex(1, 2)));
+    auto a = tree.add_sub_node(root, Complex(3, 4));
+    tree.add_sub_node(root, Complex(5, 6));
+    tree.add_sub_node(a, Complex(7, 8));
+
+    CompactTree<Complex> compact(tree);
+    CHECK(compact.values()[3] == Complex(7, 8));
+    CHECK(compact.get_parent(0) == CompactTree<Complex>::NONE);
+    CHECK(compact.get_first_child(0) == 1);
+    CHECK(compact.get_next_sibling(1) == 2);
+    CHECK(compact.get_next_sibling(2) == CompactTree<Complex>::NONE);
+    CHECK(compact.get_parent(3) == 1);
+    CHECK(compact.get_first_child(2) == CompactTree<Complex>::NONE);
+
+    auto it = compact.begin_post_order();
+    CHECK(it.index() == 3);
+    CHECK(it->get_real() == 7);
+}
+
+TEST_CASE("Freeze: BFS and DFS layouts"){
+    Tree<int, 3> tree;
+    auto root = tree.add_root(Node<int>(1));
+    auto n2 = tree.add_sub_node(root, 2);
+    auto n3 = tree.add_sub_node(root, 3);
+    tree.add_sub_node(root, 4);
+    tree.add_sub_node(n2, 5);
+    tree.add_sub_node(n2, 6);
+    tree.add_sub_node(n3, 7);
+
+    CHECK(tree.find(6).get_value() == 6);
+    CHECK(!tree.find(42).valid());
+
+    auto bfs = freeze(tree);
+    auto dfs = freeze(tree, CompactLayout::DepthFirst);
+    CHECK(bfs.get_layout() == CompactLayout::BreadthFirst);
+    CHECK(dfs.get_layout() == CompactLayout::DepthFirst);
+
+    // Storage order follows the layout.
+    CHECK(bfs.values() == vector<int>({1, 2, 3, 4, 5, 6, 7}));
+    CHECK(dfs.values() == vector<int>({1, 2, 5, 6, 3, 7, 4}));
+
+    // Both expose the same traversals as the tree.
+    string tree_bfs = node_values_of(tree.begin_bfs_scan(), tree.end_bfs_scan());
+    string tree_dfs = node_values_of(tree.begin_dfs_scan(), tree.end_dfs_scan());
+    CHECK(values_of(bfs.begin_bfs_scan(), bfs.end_bfs_scan()) == tree_bfs);
+    CHECK(values_of(dfs.begin_bfs_scan(), dfs.end_bfs_scan()) == tree_bfs);
+    CHECK(values_of(bfs.begin_dfs_scan(), bfs.end_dfs_scan()) == tree_dfs);
+    CHECK(values_of(dfs.begin_dfs_scan(), dfs.end_dfs_scan()) == tree_dfs);
+
+    CHECK(bfs.find(6) == 5);
+    CHECK(dfs.find(6) == 3);
+    CHECK(dfs.find(42) == CompactTree<int, 3>::NONE);
+    CHECK(dfs.get_parent(dfs.find(6)) == dfs.find(2));
+    CHECK(dfs.get_next_sibling(dfs.find(2)) == dfs.find(3));
+
+    Tree<int> binary;
+    auto b1 = binary.add_root(Node<int>(1));
+    auto b2 = binary.add_sub_node(b1, 2);
+    binary.add_sub_node(b1, 3);
+    binary.add_sub_node(b2, 4);
+    binary.add_sub_node(b2, 5);
+    auto frozen = freeze(binary, CompactLayout::DepthFirst);
+    CHECK(values_of(frozen.begin_in_order(), frozen.end_in_order()) == node_values_of(binary.begin_in_order(), binary.end_in_order()));
+    CHECK(values_of(frozen.begin_post_order(), frozen.end_post_order()) == node_values_of(binary.begin_post_order(), binary.end_post_order()));
+}
+
+TEST_CASE("Freeze: van Emde Boas layout"){
+    Tree<int> tree;
+    build_complete_int_tree(tree, 15);
+
+    auto veb = freeze(tree, CompactLayout::VanEmdeBoas);
+    CHECK(veb.get_layout() == CompactLayout::VanEmdeBoas);
+    CHECK(veb.height() == 4);
+    // Top half (3 nodes), then each bottom subtree of 3 nodes in its own block.
+    CHECK(veb.values() == vector<int>({0, 1, 2, 3, 7, 8, 4, 9, 10, 5, 11, 12, 6, 13, 14}));
+    CHECK(veb.get_first_child(veb.find(4)) == veb.find(4) + 1);
+
+    CHECK(values_of(veb.begin_pre_order(), veb.end_pre_order()) == node_values_of(tree.begin_pre_order(), tree.end_pre_order()));
+    CHECK(values_of(veb.begin_in_order(), veb.end_in_order()) == node_values_of(tree.begin_in_order(), tree.end_in_order()));
+    CHECK(values_of(veb.begin_post_order(), veb.end_post_order()) == node_values_of(tree.begin_post_order(), tree.end_post_order()));
+    CHECK(values_of(veb.begin_bfs_scan(), veb.end_bfs_scan()) == node_values_of(tree.begin_bfs_scan(), tree.end_bfs_scan()));
+
+    // Unbalanced: a chain hanging off the right child.
+    Tree<int> chain;
+    auto node = chain.add_root(Node<int>(0));
+    chain.add_sub_node(node, 100);
+    for (int i = 1; i < 20; i++) {
+        node = chain.add_sub_node(node, i);
+    }
+    auto chain_veb = freeze(chain, CompactLayout::VanEmdeBoas);
+    CHECK(chain_veb.size() == 21);
+    CHECK(values_of(chain_veb.begin_dfs_scan(), chain_veb.end_dfs_scan()) == node_values_of(chain.begin_dfs_scan(), chain.end_dfs_scan()));
+}
+
+TEST_CASE("Implicit tree: traversals by index arithmetic"){
+    Tree<double> tree;
+    Node<double> root_node = Node<double>(1.1);
+    tree.add_root(root_node);
+    Node<double> n1 = Node<double>(1.2);
+    Node<double> n2 = Node<double>(1.3);
+    tree.add_sub_node(root_node, n1);
+    tree.add_sub_node(root_node, n2);
+    tree.add_sub_node(n1, Node<double>(1.4));
+    tree.add_sub_node(n1, Node<double>(1.5));
+    tree.add_sub_node(n2, Node<double>(1.6));
+
+    ImplicitTree<double> implicit(tree);
+    CHECK(implicit.size() == 6);
+    CHECK(values_of(implicit.begin_pre_order(), implicit.end_pre_order()) == "1.1 1.2 1.4 1.5 1.3 1.6 ");
+    CHECK(values_of(implicit.begin_post_order(), implicit.end_post_order()) == "1.4 1.5 1.2 1.6 1.3 1.1 ");
+    CHECK(values_of(implicit.begin_in_order(), implicit.end_in_order()) == "1.4 1.2 1.5 1.1 1.6 1.3 ");
+    CHECK(values_of(implicit.begin_bfs_scan(), implicit.end_bfs_scan()) == "1.1 1.2 1.3 1.4 1.5 1.6 ");
+    CHECK(values_of(implicit.begin_dfs_scan(), implicit.end_dfs_scan()) == "1.1 1.2 1.4 1.5 1.3 1.6 ");
+    CHECK(implicit.find(1.5) == 4);
+
+    Tree<int, 3> three_ary_tree;
+    auto r = three_ary_tree.add_root(Node<int>(1));
+    auto c2 = three_ary_tree.add_sub_node(r, 2);
+    three_ary_tree.add_sub_node(r, 3);
+    three_ary_tree.add_sub_node(r, 4);
+    three_ary_tree.add_sub_node(c2, 5);
+    three_ary_tree.add_sub_node(c2, 6);
+    ImplicitTree<int, 3> implicit3(three_ary_tree);
+    CHECK(values_of(implicit3.begin_dfs_scan(), implicit3.end_dfs_scan()) == "1 2 5 6 3 4 ");
+
+    // 3 has a child while 2 has room left: not complete.
+    Tree<int, 3> gappy;
+    auto g1 = gappy.add_root(Node<int>(1));
+    gappy.add_sub_node(g1, 2);
+    auto g3 = gappy.add_sub_node(g1, 3);
+    gappy.add_sub_node(g3, 4);
+    CHECK_THROWS_AS((ImplicitTree<int, 3>(gappy)), invalid_argument);
+}
+
+TEST_CASE("Implicit tree: Eytzinger search"){
+    vector<int> sorted;
+    for (int i = 0; i < 100; i++) {
+        sorted.push_back(i * 2);
+    }
+    auto eytzinger = ImplicitTree<int>::from_sorted(sorted);
+
+    vector<int> in_order(eytzinger.begin_in_order(), eytzinger.end_in_order());
+    CHECK(in_order == sorted);
+    CHECK(eytzinger.value(eytzinger.lower_bound(0)) == 0);
+    CHECK(eytzinger.value(eytzinger.lower_bound(41)) == 42);
+    CHECK(eytzinger.value(eytzinger.lower_bound(42)) == 42);
+    CHECK(eytzinger.value(eytzinger.lower_bound(-5)) == 0);
+    CHECK(eytzinger.lower_bound(199) == ImplicitTree<int>::NONE);
+}
+
+TEST_CASE("Traversal cache: reuse until the tree changes"){
+    Tree<int> tree;
+    auto root = tree.add_root(Node<int>(5));
+    tree.add_sub_node(root, 3);
+    auto version = tree.get_version();
+
+    auto heap_begin = tree.begin_heap(); // miss: builds the heap
+    CHECK(node_values_of(heap_begin, tree.end_heap()) == "3 5 ");
+    CHECK(tree.get_cache_stats().misses == 1);
+    CHECK(tree.get_cache_stats().hits == 0);
+    CHECK(tree.begin_heap() == heap_begin); // reused, not rebuilt
+    CHECK(tree.get_cache_stats().hits == 1);
+    CHECK(tree.get_version() == version);
+
+    tree.add_sub_node(root, 1);
+    CHECK(tree.get_version() > version);
+    CHECK(node_values_of(tree.begin_heap(), tree.end_heap()) == "1 3 5 ");
+    CHECK(tree.get_cache_stats().misses == 2);
+    CHECK(tree.get_cache_stats().hits == 1);
+
+    version = tree.get_version();
+    CHECK_THROWS(tree.add_sub_node(root, 0)); // failed insertions leave the version alone
+    CHECK(tree.get_version() == version);
+}
+
+TEST_CASE("Const traversals: nested loops and concurrent readers"){
+    Tree<int> tree;
+    build_complete_int_tree(tree, 1023);
+    const Tree<int> &shared = tree;
+
+    // Nested loops over the same tree do not disturb each other.
+    size_t pairs = 0;
+    for (auto outer = shared.begin_bfs_scan(); outer != shared.end_bfs_scan(); ++outer) {
+        for (auto inner = shared.begin_bfs_scan(); inner != shared.end_bfs_scan(); ++inner) {
+            pairs++;
+        }
+    }
+    CHECK(pairs == 1023u * 1023u);
+
+    string pre = node_values_of(shared.begin_pre_order(), shared.end_pre_order());
+    string in = node_values_of(shared.begin_in_order(), shared.end_in_order());
+    string post = node_values_of(shared.begin_post_order(), shared.end_post_order());
+    string bfs = node_values_of(shared.begin_bfs_scan(), shared.end_bfs_scan());
+    vector<const Tree<int>::node_type *> heap;
+    shared.heap_into(heap);
+
+    vector<int> ok(8, 0);
+    vector<thread> readers;
+    for (size_t t = 0; t < ok.size(); t++) {
+        readers.emplace_back([&shared, &ok, t, &pre, &in, &post, &bfs, &heap]() {
+            vector<const Tree<int>::node_type *> local_heap;
+            bool same = true;
+            for (int round = 0; round < 20; round++) {
+                same = same && node_values_of(shared.begin_pre_order(), shared.end_pre_order()) == pre;
+                same = same && node_values_of(shared.begin_in_order(), shared.end_in_order()) == in;
+                same = same && node_values_of(shared.begin_post_order(), shared.end_post_order()) == post;
+                same = same && node_values_of(shared.begin_bfs_scan(), shared.end_bfs_scan()) == bfs;
+                shared.heap_into(local_heap);
+                same = same && local_heap == heap;
+            }
+            ok[t] = same ? 1 : 0;
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    CHECK(count(ok.begin(), ok.end(), 1) == (long)ok.size());
+    string heap_values;
+    for (auto node : heap) heap_values += to_string(node->get_value()) + " ";
+    CHECK(heap_values == node_values_of(shared.begin_heap(), shared.end_heap()));
+    CHECK(heap_values == node_values_of(tree.begin_heap(), tree.end_heap()));
+}
+
+TEST_CASE("Deep chains: no recursion in the helpers"){
+    const int depth = 500000;
+
+    // Unhashable values: add_sub_node by value goes through find_node, down the whole chain.
+    Tree<Point> points;
+    auto node = points.add_root(Node<Point>(Point{0, 0}));
+    for (int i = 1; i < depth; i++) {
+        node = points.add_sub_node(node, Point{i, 0});
+    }
+    points.add_sub_node(Node<Point>(Point{depth - 1, 0}), Node<Point>(Point{depth, 0}));
+    long sum = 0;
+    for (auto it = points.begin_post_order(); it != points.end_post_order(); ++it) {
+        sum += (*it)->get_value().x;
+    }
+    CHECK(sum == (long)depth * (depth + 1) / 2);
+
+    // The heap collects the nodes with the iterative DFS helper.
+    Tree<int> ints;
+    auto value = ints.add_root(Node<int>(depth));
+    for (int i = depth - 1; i >= 0; i--) {
+        value = ints.add_sub_node(value, i);
+    }
+    CHECK((*ints.begin_heap())->get_value() == 0);
+
+    // Non-trivial values: the destructor has to visit every node.
+    Tree<string> strings;
+    auto text = strings.add_root(Node<string>("root"));
+    for (int i = 1; i < depth; i++) {
+        text = strings.add_sub_node(text, "a value long enough to live on the heap " + to_string(i));
+    }
+    CHECK(strings.find("a value long enough to live on the heap 7").valid());
+}
+
+TEST_CASE("Morris traversals: same order, structure restored"){
+    Tree<int> tree;
+    auto root = tree.add_root(Node<int>(1));
+    auto n2 = tree.add_sub_node(root, 2);
+    auto n3 = tree.add_sub_node(root, 3);
+    auto n4 = tree.add_sub_node(n2, 4); // single (left) child chain below 2
+    tree.add_sub_node(n4, 5);
+    tree.add_sub_node(n4, 6);
+    tree.add_sub_node(n3, 7);
+
+    stringstream in, pre;
+    tree.morris_in_order([&in](Tree<int>::node_type *node) { in << node->get_value() << " "; });
+    tree.morris_pre_order([&pre](Tree<int>::node_type *node) { pre << node->get_value() << " "; });
+    CHECK(in.str() == node_values_of(tree.begin_in_order(), tree.end_in_order()));
+    CHECK(pre.str() == node_values_of(tree.begin_pre_order(), tree.end_pre_order()));
+
+    auto threads_left = [&tree]() {
+        int threads = 0;
+        for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) {
+            if ((*it)->child_count() < 2 && (*it)->children[1] != nullptr) threads++;
+        }
+        return threads;
+    };
+    CHECK(threads_left() == 0);
+
+    // A throwing visitor stops the visits but the tree is still unthreaded.
+    int visited = 0;
+    CHECK_THROWS_AS(tree.morris_in_order([&visited](Tree<int>::node_type *) {
+        if (++visited == 3) throw runtime_error("stop");
+    }), runtime_error);
+    CHECK(visited == 3);
+    CHECK(threads_left() == 0);
+    CHECK(node_values_of(tree.begin_in_order(), tree.end_in_order()) == in.str());
+
+    // No allocations at all.
+    long sum = 0;
+    start_counting_allocations();
+    tree.morris_in_order([&sum](Tree<int>::node_type *node) { sum += node->get_value(); });
+    CHECK(stop_counting_allocations() == 0);
+    CHECK(sum == 28);
+}
+
+TEST_CASE("Parallel BFS: same order as the sequential scan"){
+    // 16-ary tree with levels of 1, 16, 256, 4096 and 16384 nodes, the last two above the cutoff.
+    Tree<int, 16> tree;
+    vector<Tree<int, 16>::NodeHandle> handles;
+    handles.push_back(tree.add_root(Node<int>(0)));
+    for (int value = 1, parent = 0; value < 1 + 16 + 256 + 4096 + 16384; value++) {
+        if (handles[parent].get_node()->child_count() == 16) parent++;
+        handles.push_back(tree.add_sub_node(handles[parent], value));
+    }
+    vector<const Tree<int, 16>::node_type *> expected(tree.begin_bfs_scan(), tree.end_bfs_scan());
+
+    vector<const Tree<int, 16>::node_type *> out;
+    for (size_t threads : {1, 2, 3, 4}) {
+        ThreadPool pool(threads);
+        CHECK(pool.size() == threads);
+        tree.parallel_bfs_into(out, pool);
+        CHECK(out == expected);
+    }
+
+    Tree<int, 16> empty;
+    ThreadPool pool(2);
+    empty.parallel_bfs_into(out, pool);
+    CHECK(out.empty());
+
+    // The pool is a barrier and rethrows the first exception of a task.
+    vector<int> hits(100, 0);
+    pool.run(hits.size(), [&hits](size_t i) { hits[i]++; });
+    CHECK(count(hits.begin(), hits.end(), 1) == 100);
+    CHECK_THROWS_AS(pool.run(10, [](size_t i) { if (i == 7) throw runtime_error("task"); }), runtime_error);
+}
+
+TEST_CASE("Parallel reduce: sums, maxima and counts match the sequential fold"){
+    Tree<int> tree;
+    build_complete_int_tree(tree, 100000);
+    // A long chain below the last leaf makes the work very unbalanced.
+    auto tail = tree.find(99999);
+    for (int i = 100000; i < 150000; i++) {
+        tail = tree.add_sub_node(tail, i);
+    }
+    auto plus = [](long long a, long long b) { return a + b; };
+    auto as_long = [](int v) { return (long long)v; };
+    for (size_t threads : {1, 2, 4}) {
+        ThreadPool pool(threads);
+        CHECK(tree.parallel_reduce(as_long, plus, 0LL, pool) == 149999LL * 150000 / 2);
+        CHECK(tree.parallel_reduce([](int) { return (size_t)1; }, [](size_t a, size_t b) { return a + b; }, (size_t)0, pool) == 150000u);
+        CHECK(tree.parallel_reduce([](int v) { return v; }, [](int a, int b) { return max(a, b); }, -1, pool) == 149999);
+        // Any / all: bool accumulators.
+        auto either = [](bool a, bool b) { return a || b; };
+        auto both = [](bool a, bool b) { return a && b; };
+        CHECK(tree.parallel_reduce([](int v) { return v == 123456; }, either, false, pool));
+        CHECK(!tree.parallel_reduce([](int v) { return v < 0; }, either, false, pool));
+        CHECK(tree.parallel_reduce([](int v) { return v >= 0; }, both, true, pool));
+    }
+
+    Tree<Complex> complex_tree;
+    vector<Tree<Complex>::NodeHandle> handles;
+    handles.push_back(complex_tree.add_root(Node<Complex>(Complex(0, 0))));
+    for (int i = 1; i < 5000; i++) {
+        handles.push_back(complex_tree.add_sub_node(handles[(i - 1) / 2], Complex(i, -i)));
+    }
+    ThreadPool pool(3);
+    Complex sum = complex_tree.parallel_reduce([](const Complex &c) { return c; },
+                                               [](const Complex &a, const Complex &b) { return a + b; }, Complex(0, 0), pool);
+    CHECK(sum.get_real() == 4999.0 * 5000 / 2);
+    CHECK(sum.get_imag() == -4999.0 * 5000 / 2);
+    double largest = complex_tree.parallel_reduce([](const Complex &c) { return c.magnitude(); },
+                                                  [](double a, double b) { return max(a, b); }, 0.0, pool);
+    CHECK(largest == doctest::Approx(4999 * sqrt(2.0)));
+
+    Tree<int> empty;
+    CHECK(empty.parallel_reduce(as_long, plus, 7LL, pool) == 7);
+    CHECK_THROWS_AS(tree.parallel_reduce([](int v) { if (v == 120000) throw runtime_error("map"); return (long long)v; },
+                                         plus, 0LL, pool), runtime_error);
+}
+
+TEST_CASE("K-ary traversals: post-order and generalized in-order"){
+    // 1 -> (2 -> (5, 6, 7), 3 -> (8), 4): a complete 3-ary tree.
+    Tree<int, 3> tree;
+    auto r = tree.add_root(Node<int>(1));
+    auto c2 = tree.add_sub_node(r, 2);
+    auto c3 = tree.add_sub_node(r, 3);
+    tree.add_sub_node(r, 4);
+    tree.add_sub_node(c2, 5);
+    tree.add_sub_node(c2, 6);
+    tree.add_sub_node(c2, 7);
+    tree.add_sub_node(c3, 8);
+
+    const string pre = "1 2 5 6 7 3 8 4 ";
+    const string post = "5 6 7 2 8 3 4 1 ";
+    const string in = "5 2 6 7 1 8 3 4 ";
+    CHECK(node_values_of(tree.begin_pre_order(), tree.end_pre_order()) == pre);
+    CHECK(node_values_of(tree.begin_post_order(), tree.end_post_order()) == post);
+    CHECK(node_values_of(tree.begin_in_order(), tree.end_in_order()) == in);
+    const Tree<int, 3> &shared = tree;
+    CHECK(node_values_of(shared.begin_post_order(), shared.end_post_order()) == post);
+
+    for (auto layout : {CompactLayout::BreadthFirst, CompactLayout::DepthFirst}) {
+        CompactTree<int, 3> compact(tree, layout);
+        CHECK(values_of(compact.begin_post_order(), compact.end_post_order()) == post);
+        CHECK(values_of(compact.begin_in_order(), compact.end_in_order()) == in);
+    }
+    ImplicitTree<int, 3> implicit(tree);
+    CHECK(values_of(implicit.begin_post_order(), implicit.end_post_order()) == post);
+    CHECK(values_of(implicit.begin_in_order(), implicit.end_in_order()) == in);
+
+    // Bottom-up in one pass: every node comes after all of its children.
+    Tree<int, 5> wide;
+    vector<Tree<int, 5>::NodeHandle> handles;
+    handles.push_back(wide.add_root(Node<int>(0)));
+    for (int i = 1; i < 500; i++) {
+        handles.push_back(wide.add_sub_node(handles[(i - 1) / 5], i));
+    }
+    vector<int> seen(500, 0);
+    bool children_first = true;
+    for (auto it = wide.begin_post_order(); it != wide.end_post_order(); ++it) {
+        for (auto child : (*it)->get_children()) {
+            children_first = children_first && seen[child->get_value()];
+        }
+        seen[(*it)->get_value()] = 1;
+    }
+    CHECK(children_first);
+    CHECK(count(seen.begin(), seen.end(), 1) == 500);
+
+    // K = 1: a chain, post-order and in-order both run from the bottom up.
+    Tree<int, 1> chain;
+    auto link = chain.add_root(Node<int>(1));
+    link = chain.add_sub_node(link, 2);
+    chain.add_sub_node(link, 3);
+    CHECK(node_values_of(chain.begin_post_order(), chain.end_post_order()) == "3 2 1 ");
+    CHECK(node_values_of(chain.begin_in_order(), chain.end_in_order()) == "3 2 1 ");
+    ImplicitTree<int, 1> implicit_chain(chain);
+    CHECK(values_of(implicit_chain.begin_in_order(), implicit_chain.end_in_order()) == "3 2 1 ");
+}
+
+TEST_CASE("Heap traversal: ascending order, popped lazily"){
+    Tree<int, 3> tree;
+    vector<Tree<int, 3>::NodeHandle> handles;
+    vector<int> values;
+    handles.push_back(tree.add_root(Node<int>(500)));
+    values.push_back(500);
+    for (int i = 1; i < 1000; i++) {
+        int value = (i * 7919) % 1000; // a permutation of 1..999, with 500 again as a duplicate
+        handles.push_back(tree.add_sub_node(handles[(i - 1) / 3], value));
+        values.push_back(value);
+    }
+    sort(values.begin(), values.end());
+
+    vector<int> sorted;
+    for (auto it = tree.begin_heap(); it != tree.end_heap(); ++it) {
+        sorted.push_back((*it)->get_value());
+    }
+    CHECK(sorted == values);
+
+    // Smallest 5 only: the loop stops early, the cached heap is left intact for the next begin_heap.
+    string smallest;
+    auto it = tree.begin_heap();
+    for (int taken = 0; taken < 5 && it != tree.end_heap(); taken++, ++it) {
+        smallest += to_string((*it)->get_value()) + " ";
+    }
+    CHECK(smallest == "1 2 3 4 5 ");
+    CHECK((*tree.begin_heap())->get_value() == 1);
+
+    // While the cache is valid, the first k nodes only grow a frontier of at most k + 1 indices.
+    start_counting_allocations();
+    auto first = tree.begin_heap();
+    for (int taken = 0; taken < 5; taken++) ++first;
+    size_t allocations = stop_counting_allocations();
+    CHECK((*first)->get_value() == 6);
+    CHECK(allocations <= 4);
+
+    const Tree<int, 3> &shared = tree;
+    vector<int> const_sorted;
+    for (auto c = shared.begin_heap(); c != shared.end_heap(); ++c) {
+        const_sorted.push_back((*c)->get_value());
+    }
+    CHECK(const_sorted == values);
+}
+
+TEST_CASE("Selection: top_k and kth with a bounded heap"){
+    Tree<int> tree;
+    build_complete_int_tree(tree, 1000);
+    auto values = [](const vector<const Tree<int>::node_type *> &nodes) {
+        string out;
+        for (auto node : nodes) out += to_string(node->get_value()) + " ";
+        return out;
+    };
+    CHECK(values(tree.top_k(5)) == "0 1 2 3 4 ");
+    CHECK(values(tree.top_k(3, greater<int>())) == "999 998 997 ");
+    CHECK(tree.top_k(0).empty());
+    CHECK(tree.top_k(5000).size() == 1000);
+    CHECK(tree.kth(1)->get_value() == 0);
+    CHECK(tree.kth(250)->get_value() == 249);
+    CHECK(tree.kth(2, greater<int>())->get_value() == 998);
+    CHECK(tree.kth(1000)->get_value() == 999);
+    CHECK_THROWS_AS(tree.kth(0), out_of_range);
+    CHECK_THROWS_AS(tree.kth(1001), out_of_range);
+    // Past the middle kth selects from the other end: same answers, including ties and custom comparators.
+    CHECK(tree.kth(999)->get_value() == 998);
+    CHECK(tree.kth(501)->get_value() == 500);
+    CHECK(tree.kth(900, greater<int>())->get_value() == 100);
+    auto by_tens = [](int a, int b) { return a / 10 < b / 10; };
+    CHECK(tree.kth(995, by_tens)->get_value() / 10 == 99);
+    CHECK(tree.kth(5, by_tens)->get_value() / 10 == 0);
+
+    // Complex values are ordered by magnitude.
+    Tree<Complex> complex_tree;
+    auto root = complex_tree.add_root(Node<Complex>(Complex(3, 4)));
+    auto left = complex_tree.add_sub_node(root, Complex(0, 1));
+    complex_tree.add_sub_node(root, Complex(-6, 8));
+    complex_tree.add_sub_node(left, Complex(1, 1));
+    complex_tree.add_sub_node(left, Complex(0, -2));
+    stringstream smallest, largest;
+    for (auto node : complex_tree.top_k(3)) smallest << node->get_value() << " ";
+    for (auto node : complex_tree.top_k(2, greater<Complex>())) largest << node->get_value() << " ";
+    CHECK(smallest.str() == "0+1i 1+1i 0+-2i ");
+    CHECK(largest.str() == "-6+8i 3+4i ");
+    CHECK(complex_tree.kth(4)->get_value() == Complex(3, 4));
+
+    // O(k) memory: the selection never holds more than k nodes
+    // (allocations: the DFS stack, the k keyed candidates and the result).
+    start_counting_allocations();
+    auto three = tree.top_k(3);
+    CHECK(stop_counting_allocations() <= 3);
+    CHECK(three.size() == 3);
+}
+
+template <int K, typename Compare = std::less<int>>
+static vector<int> drain(DaryHeap<int, K, Compare> &heap)
+{
+    vector<int> out;
+    while (!heap.empty()) out.push_back(heap.pop());
+    return out;
+}
+
+TEST_CASE("D-ary heap: push, pop and decrease-key through handles"){
+    vector<int> values;
+    for (int i = 0; i < 500; i++) values.push_back((i * 7919) % 500);
+    vector<int> sorted = values;
+    sort(sorted.begin(), sorted.end());
+
+    DaryHeap<int, 2> binary;
+    DaryHeap<int, 3> ternary;
+    DaryHeap<int, 8> octal;
+    for (int v : values) {
+        binary.push(v);
+        ternary.push(v);
+        octal.push(v);
+    }
+    CHECK(octal.get_k() == 8);
+    CHECK(octal.top() == 0);
+    // values() is a complete K-ary tree in BFS order with the heap property.
+    ImplicitTree<int, 8> view(octal.values());
+    bool heap_ordered = true;
+    for (size_t i = 1; i < view.size(); i++) heap_ordered = heap_ordered && view.value(ImplicitIndex<8>::parent(i)) <= view.value(i);
+    CHECK(heap_ordered);
+    CHECK(drain(binary) == sorted);
+    CHECK(drain(ternary) == sorted);
+    CHECK(drain(octal) == sorted);
+    CHECK_THROWS_AS(octal.pop(), out_of_range);
+    CHECK_THROWS_AS(octal.top(), out_of_range);
+
+    DaryHeap<int, 4> heap;
+    auto a = heap.push(50);
+    auto b = heap.push(40);
+    auto c = heap.push(30);
+    heap.push(20);
+    heap.decrease_key(a, 10);
+    CHECK(heap.top() == 10);
+    CHECK(heap.get(a) == 10);
+    CHECK_THROWS_AS(heap.decrease_key(b, 45), invalid_argument);
+    heap.update(c, 60); // increase
+    CHECK(heap.pop() == 10);
+    CHECK_FALSE(heap.contains(a));
+    CHECK_THROWS_AS(heap.decrease_key(a, 1), invalid_argument);
+    auto d = heap.push(5); // reuses the id of a
+    CHECK(heap.contains(d));
+    CHECK(d != a);
+    CHECK_FALSE(heap.contains(a)); // stale: a newer generation of the same id
+    CHECK_THROWS_AS(heap.decrease_key(a, 1), invalid_argument);
+    CHECK_THROWS_AS(heap.update(a, 1), invalid_argument);
+    CHECK(heap.get(d) == 5);
+    CHECK(heap.get(b) == 40);
+    CHECK(drain(heap) == vector<int>({5, 20, 40, 60}));
+
+    auto e = heap.push(1);
+    heap.clear();
+    auto f = heap.push(2);
+    CHECK_FALSE(heap.contains(e)); // clear makes the handles stale too
+    CHECK(heap.contains(f));
+    heap.clear();
+
+    DaryHeap<int, 4, greater<int>> max_heap;
+    for (int v : {3, 9, 1, 7}) max_heap.push(v);
+    CHECK(drain(max_heap) == vector<int>({9, 7, 3, 1}));
+}
+
+TEST_CASE("Complex array: SIMD kernels match the scalar operators"){
+    // 37 values: several full packs and a scalar tail at every SIMD width.
+    vector<Complex> a, b;
+    for (int i = 0; i < 37; i++) {
+        a.push_back(Complex(i * 0.5 - 3, 7 - i * 0.25));
+        b.push_back(Complex(1 + i % 5, i % 3 - 1.5));
+    }
+    ComplexArray xs(a), ys(b);
+    CHECK(xs.size() == 37);
+    CHECK(xs[5] == a[5]);
+
+    ComplexArray sum = xs + ys, difference = xs - ys, product = xs * ys, quotient = xs / ys;
+    vector<double> magnitudes, squared;
+    xs.magnitude(magnitudes);
+    xs.magnitude_squared(squared);
+    bool same = true;
+    for (size_t i = 0; i < a.size(); i++) {
+        same = same && sum[i] == a[i] + b[i];
+        same = same && difference[i] == a[i] - b[i];
+        same = same && product[i].get_real() == doctest::Approx((a[i] * b[i]).get_real());
+        same = same && product[i].get_imag() == doctest::Approx((a[i] * b[i]).get_imag());
+        same = same && quotient[i].get_real() == doctest::Approx((a[i] / b[i]).get_real());
+        same = same && quotient[i].get_imag() == doctest::Approx((a[i] / b[i]).get_imag());
+        same = same && magnitudes[i] == doctest::Approx(a[i].magnitude());
+        same = same && squared[i] == doctest::Approx(a[i].magnitude() * a[i].magnitude());
+    }
+    CHECK(same);
+    ComplexArray in_place = xs;
+    in_place *= ys;
+    in_place -= product;
+    CHECK(in_place[36] == Complex(0, 0));
+    CHECK_THROWS_AS(xs + ComplexArray(3), invalid_argument);
+}
+
+TEST_CASE("Complex array: value store of a compact Tree<Complex>"){
+    static_assert(is_same<CompactTree<Complex>::store_type, ComplexArray>::value, "Complex values are split up");
+    static_assert(is_same<CompactTree<int>::store_type, vector<int>>::value, "other values stay in a vector");
+
+    Tree<Complex> tree;
+    auto root = tree.add_root(Node<Complex>(Complex(3, 4)));
+    auto a = tree.add_sub_node(root, Complex(0, 1));
+    tree.add_sub_node(root, Complex(6, 8));
+    tree.add_sub_node(a, Complex(-5, 12));
+
+    // The kernels run over the frozen values directly, indexed by node.
+    auto compact = freeze(tree);
+    const ComplexArray &values = compact.values();
+    vector<double> magnitudes;
+    values.magnitude(magnitudes);
+    CHECK(magnitudes == vector<double>({5, 1, 10, 13}));
+    CHECK(compact.value(3) == Complex(-5, 12));
+    CHECK(compact.find(Complex(6, 8)) == 2);
+
+    // Bulk update in place: rotate every value by i, the topology is untouched.
+    ComplexArray by_i(compact.size());
+    for (size_t i = 0; i < by_i.size(); i++)
+        by_i.set(i, Complex(0, 1));
+    compact.update_values([&by_i](ComplexArray &store) { store *= by_i; });
+    vector<Complex> pre_order(compact.begin_pre_order(), compact.end_pre_order());
+    CHECK(pre_order == vector<Complex>({Complex(-4, 3), Complex(-1, 0), Complex(-12, -5), Complex(-8, 6)}));
+    CHECK(compact.get_first_child(1) == 3);
+    CHECK(compact.begin_post_order()->get_real() == -12);
+    CHECK_THROWS_AS(compact.update_values([](ComplexArray &store) { store.push_back(Complex(0, 0)); }),
+                    length_error);
+
+    // The van Emde Boas renumbering moves the values between two ComplexArrays.
+    auto veb = freeze(tree, CompactLayout::VanEmdeBoas);
+    vector<Complex> veb_pre_order(veb.begin_pre_order(), veb.end_pre_order());
+    CHECK(veb_pre_order == vector<Complex>({Complex(3, 4), Complex(0, 1), Complex(-5, 12), Complex(6, 8)}));
+}
+
+// A value type whose OrderKey counts how many keys were extracted.
+struct Counted {
+    int v;
+    static size_t keys;
+    bool operator<(const Counted &other) const { return v < other.v; }
+    bool operator==(const Counted &other) const { return v == other.v; }
+};
+size_t Counted::keys = 0;
+
+template <>
+struct OrderKey<Counted> {
+    static constexpr bool cached = true;
+    using type = int;
+    static type of(const Counted &value) { Counted::keys++; return value.v; }
+    static bool less(type a, type b) { return a < b; }
+};
+
+TEST_CASE("Order keys: one key per node for heap and selection"){
+    CHECK(Complex(3, 4).magnitude_squared() == 25);
+    CHECK(OrderKey<Complex>::cached);
+    CHECK(OrderKey<int>::cached);
+    CHECK_FALSE(OrderKey<string>::cached);
+    CHECK(OrderKey<Complex>::of(Complex(1, 2)) == 5);
+
+    Tree<Complex> tree;
+    vector<Tree<Complex>::NodeHandle> handles;
+    vector<double> magnitudes;
+    handles.push_back(tree.add_root(Node<Complex>(Complex(0, 0))));
+    magnitudes.push_back(0);
+    for (int i = 1; i < 300; i++) {
+        Complex value((i * 37) % 101 - 50, (i * 11) % 53 - 26);
+        handles.push_back(tree.add_sub_node(handles[(i - 1) / 2], value));
+        magnitudes.push_back(value.magnitude());
+    }
+    sort(magnitudes.begin(), magnitudes.end());
+
+    vector<double> heap_order;
+    for (auto it = tree.begin_heap(); it != tree.end_heap(); ++it) heap_order.push_back((*it)->get_value().magnitude());
+    CHECK(heap_order == magnitudes);
+
+    // Keyed selection (std::less / std::greater) agrees with selection by a custom comparator.
+    auto by_magnitude = [](const Complex &a, const Complex &b) { return a.magnitude() < b.magnitude(); };
+    auto keyed = tree.top_k(10);
+    auto compared = tree.top_k(10, by_magnitude);
+    bool same = keyed.size() == compared.size();
+    for (size_t i = 0; same && i < keyed.size(); i++) same = keyed[i]->get_value().magnitude() == compared[i]->get_value().magnitude();
+    CHECK(same);
+    CHECK(tree.kth(300, greater<Complex>())->get_value() == Complex(0, 0));
+    CHECK(tree.kth(1, greater<Complex>())->get_value().magnitude() == magnitudes.back());
+
+    // Types without a cached key still order through their operator<.
+    Tree<string> words;
+    auto w = words.add_root(Node<string>("pear"));
+    words.add_sub_node(w, "apple");
+    words.add_sub_node(w, "fig");
+    CHECK(node_values_of(words.begin_heap(), words.end_heap()) == "apple fig pear ");
+    CHECK(words.kth(2)->get_value() == "fig");
+
+    // heap_into sorts precomputed keys: one extraction per node.
+    Tree<Counted> counted;
+    vector<Tree<Counted>::NodeHandle> counted_handles;
+    counted_handles.push_back(counted.add_root(Node<Counted>(Counted{500})));
+    for (int i = 1; i < 1000; i++) {
+        counted_handles.push_back(counted.add_sub_node(counted_handles[(i - 1) / 2], Counted{(i * 7919) % 1000}));
+    }
+    vector<const Tree<Counted>::node_type *> sorted;
+    Counted::keys = 0;
+    counted.heap_into(sorted);
+    CHECK(Counted::keys == 1000);
+    CHECK(sorted.size() == 1000);
+    CHECK(is_sorted(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->get_value() < b->get_value(); }));
+}
+
+TEST_CASE("Subtree aggregates: maintained on insertion"){
+    // 1 -> (2 -> (4, 5), 3 -> (6))
+    Tree<int, 2, Aggregates<SumAggregate<int>, MinAggregate<int>, MaxAggregate<int>, CountAggregate<int>>> tree;
+    auto n1 = tree.add_root(Node<int>(1));
+    auto n2 = tree.add_sub_node(n1, 2);
+    auto n3 = tree.add_sub_node(n1, 3);
+    CHECK(tree.tree_aggregate() == make_tuple(6, 1, 3, (size_t)3));
+    auto n4 = tree.add_sub_node(n2, 4);
+    tree.add_sub_node(Node<int>(2), Node<int>(5));
+    auto n6 = tree.add_sub_node(n3, 6);
+    CHECK(tree.tree_aggregate() == make_tuple(21, 1, 6, (size_t)6));
+    CHECK(tree.subtree_aggregate(n2) == make_tuple(11, 2, 5, (size_t)3));
+    CHECK(tree.subtree_aggregate(n3) == make_tuple(9, 3, 6, (size_t)2));
+    CHECK(tree.subtree_aggregate(n4) == make_tuple(4, 4, 4, (size_t)1));
+    CHECK(tree.subtree_aggregate(n6) == make_tuple(6, 6, 6, (size_t)1));
+    CHECK_THROWS_AS(tree.subtree_aggregate(decltype(tree)::NodeHandle()), runtime_error);
+    decltype(tree) other;
+    CHECK_THROWS_AS(other.subtree_aggregate(n2), runtime_error);
+    // Traversals are unaffected by the extra node state.
+    CHECK(node_values_of(tree.begin_pre_order(), tree.end_pre_order()) == "1 2 4 5 3 6 ");
+
+    // Complex: the sum, and the value of largest magnitude.
+    Tree<Complex, 3, Aggregates<SumAggregate<Complex>, MaxAggregate<Complex>>> complex_tree;
+    auto root = complex_tree.add_root(Node<Complex>(Complex(1, 1)));
+    auto left = complex_tree.add_sub_node(root, Complex(3, 4));
+    complex_tree.add_sub_node(root, Complex(-6, 8));
+    complex_tree.add_sub_node(left, Complex(0, -2));
+    CHECK(get<0>(complex_tree.tree_aggregate()) == Complex(-2, 11));
+    CHECK(get<1>(complex_tree.tree_aggregate()) == Complex(-6, 8));
+    CHECK(get<0>(complex_tree.subtree_aggregate(left)) == Complex(3, 2));
+    CHECK(get<1>(complex_tree.subtree_aggregate(left)) == Complex(3, 4));
+
+    // Doubles, a deep chain and a snapshot of an aggregated tree.
+    Tree<double, 2, SumAggregate<double>> chain;
+    auto link = chain.add_root(Node<double>(0.5));
+    auto top = link;
+    for (int i = 0; i < 1000; i++) link = chain.add_sub_node(link, 0.5);
+    CHECK(chain.subtree_aggregate(top) == 500.5);
+    CHECK(chain.subtree_aggregate(link) == 0.5);
+    CHECK(freeze(chain).size() == 1001);
+
+    Tree<string, 2, SumAggregate<string>> words;
+    auto w = words.add_root(Node<string>("a"));
+    words.add_sub_node(w, "b");
+    words.add_sub_node(words.add_sub_node(w, "c"), "d");
+    CHECK(words.tree_aggregate() == "abcd"); // pre-order: combine does not need to commute
+}
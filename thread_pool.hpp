@@ -0,0 +1,175 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    ThreadPool: a fixed set of worker threads for fork-join loops.
+    run(tasks, fn) calls fn(0) .. fn(tasks - 1) spread over the workers and the calling thread, and returns
+    once all of them finished - every call is a barrier. Tasks are handed out through an atomic counter,
+    so uneven tasks balance themselves. The first exception thrown by a task is rethrown by run().
+    run() itself must not be called concurrently or from inside a task.
+*/
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(std::size_t)> *job;
+    std::size_t job_tasks;
+    std::atomic<std::size_t> next_task;
+    std::size_t busy_workers;
+    unsigned long generation;
+    bool stopping;
+    std::exception_ptr failure;
+
+    void work()
+    {
+        for (std::size_t task = next_task++; task < job_tasks; task = next_task++)
+        {
+            try
+            {
+                (*job)(task);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!failure)
+                    failure = std::current_exception();
+            }
+        }
+    }
+
+    void worker_loop()
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy_workers == 0)
+                finished.notify_one();
+        }
+    }
+
+public:
+    // threads is the total parallelism including the calling thread (0 = hardware concurrency).
+    explicit ThreadPool(std::size_t threads = 0)
+        : job(nullptr), job_tasks(0), next_task(0), busy_workers(0), generation(0), stopping(false)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (std::size_t i = 1; i < threads; i++)
+        {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t size() const { return workers.size() + 1; }
+
+    void run(std::size_t tasks, const std::function<void(std::size_t)> &fn)
+    {
+        if (tasks == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            job_tasks = tasks;
+            next_task = 0;
+            busy_workers = workers.size();
+            failure = nullptr;
+            generation++;
+        }
+        wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy_workers == 0; });
+        job = nullptr;
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+};
+
+/*
+    WorkStealingDeque: the task queue of one worker in a work-stealing loop.
+    The owner pushes and pops at the back (newest, usually smallest task first), idle workers steal from
+    the front (oldest, usually largest task). A plain mutex per deque is enough because the tasks handed
+    out are coarse: callers batch the fine-grained work themselves.
+*/
+template <typename Task>
+class WorkStealingDeque
+{
+private:
+    std::deque<Task> tasks;
+    mutable std::mutex mutex;
+
+public:
+    void push(const Task &task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+
+    template <typename It>
+    void push(It first, It last)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.insert(tasks.end(), first, last);
+    }
+
+    bool pop(Task &task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty())
+            return false;
+        task = tasks.back();
+        tasks.pop_back();
+        return true;
+    }
+
+    bool steal(Task &task)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty())
+            return false;
+        task = tasks.front();
+        tasks.pop_front();
+        return true;
+    }
+};
+
+#endif // THREAD_POOL_HPP
@@ -2,17 +2,29 @@
 #define TREE_HPP
 
 #include "node.hpp"
+#include "node_pool.hpp"
+#include "tree_iterators.hpp"
+#include "thread_pool.hpp"
+#include "order_key.hpp"
+#include "aggregate.hpp"
 #include <cstddef>
 #include <vector>
-#include <queue>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <SFML/Graphics.hpp>
 #include <type_traits>
 #include <string>
 #include <sstream>
-#include <map>
-#include <iomanip> 
+#include <unordered_map>
+#include <utility>
+#include <iomanip>
+#include <exception>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <memory>
 
 /*
     Tree: A class that represents a tree data structure. 
@@ -28,50 +40,190 @@
 
 const float NODE_RADIUS = 50.0f; // constant for the radius of the nodes (GUI)
 
-template <typename T, int K = 2> // by default, K is 2 (Binary tree)
+/*
+    is_hashable: true when std::hash<U> is usable, i.e. U can key the tree's value index.
+*/
+template <typename U, typename = void>
+struct is_hashable : std::false_type {};
+
+template <typename U>
+struct is_hashable<U, std::void_t<decltype(std::hash<U>()(std::declval<const U &>()))>> : std::true_type {};
+
+/*
+    Aggregate is an optional policy from aggregate.hpp (e.g. SumAggregate<T>, Aggregates<...>): when given,
+    every node keeps the aggregate of its subtree, see subtree_aggregate.
+*/
+template <typename T, int K = 2, typename Aggregate = void> // by default, K is 2 (Binary tree)
 class Tree
 {
+public:
+    static_assert(K >= 1, "A tree must allow at least one child per node.");
+    using node_type = Node<T, K>; // nodes store up to K child pointers inline
+
+private:
+    static constexpr bool has_aggregate = !std::is_void<Aggregate>::value;
+    struct NoAggregate
+    {
+        using value_type = char;
+        static value_type lift(const T &) { return 0; }
+    };
+    using aggregate_policy = typename std::conditional<has_aggregate, Aggregate, NoAggregate>::type;
+
+public:
+    using aggregate_type = typename aggregate_policy::value_type;
+
 private:
-    Node<T> *root;
+    /*
+    * With an Aggregate policy the pool holds AggregatedNodes: the node plus its parent and the aggregate of
+    * its subtree. Everything else, traversals included, works on the node_type base.
+    */
+    struct AggregatedNode : node_type
+    {
+        node_type *parent;
+        aggregate_type aggregate;
+
+        AggregatedNode(const T &value) : node_type(value), parent(nullptr), aggregate(aggregate_policy::lift(value)) {}
+    };
+    using stored_node = typename std::conditional<has_aggregate, AggregatedNode, node_type>::type;
+
+    node_type *root;
+    NodePool<stored_node> pool; // owns the memory of every node in the tree
+    /*
+    * Value -> node index used to resolve parents in add_sub_node(Node, Node) and find in O(1) on average.
+    * It is built by the first lookup by value and kept up to date from then on, so trees built through
+    * handles never pay for it. The keys point at the values inside the nodes (nodes never move), so values
+    * are not stored twice.
+    * With duplicate values a lookup resolves to the node inserted first, whenever the index was built:
+    * it is filled in creation order (the pool's slot order) and later insertions never replace an entry.
+    * Types without std::hash fall back to the linear find_node scan, which uses the same order.
+    */
+    struct ValueHash
+    {
+        size_t operator()(const T *value) const { return std::hash<T>()(*value); }
+    };
+    struct ValueEqual
+    {
+        bool operator()(const T *lhs, const T *rhs) const { return *lhs == *rhs; }
+    };
+    struct NoValueIndex {};
+    static constexpr bool has_value_index = is_hashable<T>::value;
+    typename std::conditional<has_value_index, std::unordered_map<const T *, node_type *, ValueHash, ValueEqual>,
+                              NoValueIndex>::type value_index;
+    bool value_indexed; // value_index has been built
     bool is_binary_tree;
     int k;
     /*
-    * The following vectors are used to store the nodes in the order of traversal.
+    * Mutation version, bumped by add_root and add_sub_node.
+    * A materialized traversal is cached with the version it was built at and reused while that still matches.
+    * Only structural changes made through the Tree are tracked, not values edited in place through node pointers.
     */
-    std::vector<Node<T> *> pre_order_nodes;
-    std::vector<Node<T> *> post_order_nodes;
-    std::vector<Node<T> *> in_order_nodes;
-    std::vector<Node<T> *> bfs_nodes;
-    std::vector<Node<T> *> dfs_nodes;
-    std::vector<Node<T> *> heap_nodes;
+    unsigned long long version;
+    using heap_entry = typename HeapIterator<node_type>::Entry; // (OrderKey, node)
+    std::vector<heap_entry> heap_entries; // heap order, valid for heap_version
+    unsigned long long heap_version;
+    size_t cache_hits;
+    size_t cache_misses;
+    std::vector<node_type *> work_stack; // explicit stack of the iterative helpers, reused between calls
+    /*
+    * Renderer cache, created by the first drawTree: trees that are never drawn hold no SFML objects, whose
+    * constructors and destructors live in libsfml-graphics.
+    * layout has one entry per node in placement order, with the node's position and the index of its
+    * parent's entry (for the edge); labels holds the node's text, laid out once, at the same index.
+    * The cache is valid for version, size and font, so drawTree only lays the tree out again after an
+    * insertion, a resize or with another font. edges (sf::Lines) and discs (one
+    * textured quad per node, as two sf::Triangles) hold the geometry of the whole layout, so a frame draws
+    * all edges and all nodes with two draw calls.
+    * A shared_ptr binds its deleter where the cache is created, so ~Tree does not instantiate ~RenderCache.
+    */
+    struct LayoutEntry
+    {
+        sf::Vector2f position;
+        size_t parent; // index into layout, NO_PARENT for the root
+    };
+    static constexpr size_t NO_PARENT = static_cast<size_t>(-1);
+    struct RenderCache
+    {
+        std::vector<LayoutEntry> layout;
+        std::vector<sf::Text> labels;
+        unsigned long long version;
+        sf::Vector2u size;
+        const sf::Font *font;
+        sf::VertexArray edges;
+        sf::VertexArray discs;
+        sf::Texture disc_texture; // a NODE_RADIUS disc on a transparent square
+
+        RenderCache() : version(0), font(nullptr), edges(sf::Lines), discs(sf::Triangles) {}
+    };
+    std::shared_ptr<RenderCache> render_cache;
 
 
 public:
+    using dfs_iterator = DepthFirstIterator<node_type>;
+    using bfs_iterator = BreadthFirstIterator<node_type>;
+    using const_dfs_iterator = DepthFirstIterator<const node_type>;
+    using const_bfs_iterator = BreadthFirstIterator<const node_type>;
+    using heap_iterator = HeapIterator<node_type>;
+    using const_heap_iterator = HeapIterator<const node_type>;
+
     // Constructor
-    Tree() : root(nullptr), is_binary_tree(K == 2) {
+    Tree() : root(nullptr), value_indexed(false), is_binary_tree(K == 2), version(1), heap_version(0), cache_hits(0), cache_misses(0) {
         k = K;
     }
-    // Destructor
+    // Destructor: destroys the nodes, the pool then frees its chunks.
     ~Tree()
     {
-        delete_tree(root);
+        if constexpr (!std::is_trivially_destructible<stored_node>::value)
+        {
+            delete_tree(root);
+        }
     }
 
+    Tree(const Tree &) = delete;
+    Tree &operator=(const Tree &) = delete;
+
     int get_k() const
     {
         return k;
     }
 
-    void add_root(const Node<T> &node)
+    /*
+    * NodeHandle: a lightweight, stable reference to a node of this tree, returned by the insertion functions.
+    * Nodes never move, so a handle stays valid for the lifetime of the tree it came from.
+    * Inserting below a handle skips the parent lookup and is unambiguous with duplicate values.
+    * A handle remembers the tree that issued it; passing it to another tree throws.
+    */
+    class NodeHandle
+    {
+    private:
+        const Tree *owner;
+        node_type *node;
+        NodeHandle(const Tree *t, node_type *n) : owner(t), node(n) {}
+        friend class Tree;
+
+    public:
+        NodeHandle() : owner(nullptr), node(nullptr) {}
+
+        bool valid() const { return node != nullptr; }
+        const T &get_value() const { return node->value; }
+        node_type *get_node() const { return node; }
+
+        bool operator==(const NodeHandle &other) const { return node == other.node; }
+        bool operator!=(const NodeHandle &other) const { return node != other.node; }
+    };
+
+    NodeHandle add_root(const Node<T> &node)
     {
         if (root != nullptr)
         {
             throw std::runtime_error("Root node already exists.");
         }
-        root = new Node<T>(node.get_value());
+        root = pool.create(node.get_value());
+        index_node(root);
+        version++;
+        return NodeHandle(this, root);
     }
 
-    void add_sub_node(const Node<T> &parent, const Node<T> &child)
+    NodeHandle add_sub_node(const Node<T> &parent, const Node<T> &child)
     {
         
         if (root == nullptr)
@@ -79,123 +231,438 @@ public:
             throw std::runtime_error("Root node not found.");
         }
         
-        Node<T> *parent_ptr = find_node(root, parent.get_value());
-
-        if (parent_ptr->children.size() >= (size_t)this->k)
-        {
-            throw std::runtime_error("Node has reached the maximum number of children.");
-        }
+        return NodeHandle(this, attach(lookup(parent.get_value()), child.get_value()));
+    }
 
-        if (parent_ptr == nullptr)
-        {
-            throw std::runtime_error("Parent node not found.");
-        }
-        //std::cout << "children= " << parent_ptr->children.size() << "Tree K= " << k << std::endl;
-        parent_ptr->add_child(child);
+    // Inserts value below the node referred to by parent, without searching for it.
+    NodeHandle add_sub_node(NodeHandle parent, const T &value)
+    {
+        check_owner(parent);
+        return NodeHandle(this, attach(parent.node, value));
     }
 
-    Node<T>* getRoot() const
+    node_type* getRoot() const
     {
         return root;
     }
 
-    typename std::vector<Node<T> *>::iterator begin_pre_order()
+    unsigned long long get_version() const
     {
-        if (K != 2)
-        {
-            return begin_dfs_scan();
-        }
-        pre_order_nodes.clear();
-        pre_order_helper(root, pre_order_nodes);
-        return pre_order_nodes.begin();
+        return version;
     }
 
-    typename std::vector<Node<T> *>::iterator end_pre_order()
+    // Hits and misses of the traversal cache since the tree was created.
+    struct CacheStats
     {
-        if (K != 2)
-        {
-            return end_dfs_scan();
-        }
-        return pre_order_nodes.end();
+        size_t hits;
+        size_t misses;
+    };
+
+    CacheStats get_cache_stats() const
+    {
+        return CacheStats{cache_hits, cache_misses};
     }
 
-    typename std::vector<Node<T> *>::iterator begin_post_order()
+    /*
+    * Subtree aggregates (trees with an Aggregate policy): the aggregate of all values in the subtree of
+    * node, in O(1). Each insertion updates the aggregates along the path to the root in O(depth * K).
+    * Values changed in place through node pointers are not tracked.
+    */
+    const aggregate_type &subtree_aggregate(NodeHandle node) const
     {
-        if (K != 2)
+        static_assert(has_aggregate, "The tree has no Aggregate policy.");
+        if (!node.valid())
         {
-            return begin_dfs_scan();
+            throw std::runtime_error("Node not found.");
         }
-        post_order_nodes.clear();
-        post_order_helper(root, post_order_nodes);
-        return post_order_nodes.begin();
+        check_owner(node);
+        return static_cast<const AggregatedNode *>(node.node)->aggregate;
     }
 
-    typename std::vector<Node<T> *>::iterator end_post_order()
+    // Aggregate of the whole tree.
+    const aggregate_type &tree_aggregate() const
     {
-        if (K != 2)
+        static_assert(has_aggregate, "The tree has no Aggregate policy.");
+        if (root == nullptr)
         {
-            return end_dfs_scan();
+            throw std::runtime_error("Tree is empty.");
         }
-        return post_order_nodes.end();
+        return static_cast<const AggregatedNode *>(root)->aggregate;
+    }
+
+    // Handle to the node holding value (with duplicates, the one inserted first), or an invalid handle.
+    NodeHandle find(const T &value)
+    {
+        return NodeHandle(this, root == nullptr ? nullptr : lookup(value));
+    }
+
+    /*
+    * Traversals: begin/end pairs over the lazy iterators of tree_iterators.hpp.
+    * They work for any K: post-order yields every node after all of its children, and in-order is
+    * generalized to first child's subtree, the node, then the remaining children's subtrees.
+    * The const overloads yield const nodes. All traversal state lives in the iterator, so any number of
+    * threads (or nested loops) can walk one tree at the same time as long as nobody inserts meanwhile.
+    */
+    dfs_iterator begin_pre_order()
+    {
+        return dfs_iterator(root, DepthFirstOrder::PreOrder);
+    }
+
+    const_dfs_iterator begin_pre_order() const
+    {
+        return const_dfs_iterator(root, DepthFirstOrder::PreOrder);
+    }
+
+    dfs_iterator end_pre_order()
+    {
+        return dfs_iterator();
+    }
+
+    const_dfs_iterator end_pre_order() const
+    {
+        return const_dfs_iterator();
+    }
+
+    dfs_iterator begin_post_order()
+    {
+        return dfs_iterator(root, DepthFirstOrder::PostOrder);
+    }
+
+    const_dfs_iterator begin_post_order() const
+    {
+        return const_dfs_iterator(root, DepthFirstOrder::PostOrder);
     }
 
-    typename std::vector<Node<T> *>::iterator begin_in_order()
+    dfs_iterator end_post_order()
     {
-        if (K != 2)
+        return dfs_iterator();
+    }
+
+    const_dfs_iterator end_post_order() const
+    {
+        return const_dfs_iterator();
+    }
+
+    dfs_iterator begin_in_order()
+    {
+        return dfs_iterator(root, DepthFirstOrder::InOrder);
+    }
+
+    const_dfs_iterator begin_in_order() const
+    {
+        return const_dfs_iterator(root, DepthFirstOrder::InOrder);
+    }
+
+    dfs_iterator end_in_order()
+    {
+        return dfs_iterator();
+    }
+
+    const_dfs_iterator end_in_order() const
+    {
+        return const_dfs_iterator();
+    }
+
+    bfs_iterator begin_bfs_scan()
+    {
+        return bfs_iterator(root);
+    }
+
+    const_bfs_iterator begin_bfs_scan() const
+    {
+        return const_bfs_iterator(root);
+    }
+
+    bfs_iterator end_bfs_scan()
+    {
+        return bfs_iterator();
+    }
+
+    const_bfs_iterator end_bfs_scan() const
+    {
+        return const_bfs_iterator();
+    }
+
+    dfs_iterator begin_dfs_scan()
+    {
+        return dfs_iterator(root, DepthFirstOrder::PreOrder);
+    }
+
+    const_dfs_iterator begin_dfs_scan() const
+    {
+        return const_dfs_iterator(root, DepthFirstOrder::PreOrder);
+    }
+
+    dfs_iterator end_dfs_scan()
+    {
+        return dfs_iterator();
+    }
+
+    const_dfs_iterator end_dfs_scan() const
+    {
+        return const_dfs_iterator();
+    }
+
+    /*
+    * Heap traversal: the nodes in ascending order of their values, one step per ++.
+    * Every node's OrderKey is extracted once and the heap compares keys only.
+    * The heapified array is cached (see refresh_heap) and begin_heap walks it in place without copying it
+    * (see HeapIterator), so the k smallest nodes cost O(n + k log k) after a change, and O(k log k) while
+    * the cache is valid. Inserting into the tree invalidates the iterators in use.
+    * The const overload heapifies a fresh array owned by its iterator instead of using the shared cache.
+    * The heap is meant for loops that stop early; to walk every node in order, heap_into sorts the keys once,
+    * which is several times faster than popping all of them.
+    */
+    heap_iterator begin_heap()
+    {
+        refresh_heap();
+        return heap_iterator(&heap_entries);
+    }
+
+    const_heap_iterator begin_heap() const
+    {
+        std::vector<typename const_heap_iterator::Entry> entries;
+        for (auto node = begin_dfs_scan(); node != end_dfs_scan(); ++node)
         {
-            return begin_dfs_scan();
+            entries.push_back(const_heap_iterator::entry(*node));
         }
-        in_order_nodes.clear();
-        in_order_helper(root, in_order_nodes);
-        return in_order_nodes.begin();
+        return const_heap_iterator(std::move(entries));
+    }
+
+    heap_iterator end_heap()
+    {
+        return heap_iterator();
     }
 
-    typename std::vector<Node<T> *>::iterator end_in_order()
+    const_heap_iterator end_heap() const
     {
-        if (K != 2)
+        return const_heap_iterator();
+    }
+
+    /*
+    * Const, reentrant heap: fills the caller's buffer with the nodes in the order begin_heap yields them
+    * (ascending by OrderKey), without using the shared cache. Each node's key is extracted once into a
+    * scratch array of (key, node) entries, which is sorted, so the sort compares keys only.
+    * Reusing one buffer per thread avoids reallocating it on every call.
+    */
+    void heap_into(std::vector<const node_type *> &buffer) const
+    {
+        using entry = typename const_heap_iterator::Entry;
+        std::vector<entry> entries;
+        entries.reserve(pool.size());
+        for (auto node = begin_dfs_scan(); node != end_dfs_scan(); ++node)
         {
-            return end_dfs_scan();
+            entries.push_back(const_heap_iterator::entry(*node));
+        }
+        std::sort(entries.begin(), entries.end(), [](const entry &lhs, const entry &rhs) {
+            return const_heap_iterator::later(rhs, lhs);
+        });
+        buffer.clear();
+        for (const auto &e : entries)
+        {
+            buffer.push_back(e.node);
         }
-        return in_order_nodes.end();
     }
 
-    typename std::vector<Node<T> *>::iterator begin_bfs_scan()
+    /*
+    * Selection queries over one streaming DFS pass, with a bounded heap of k nodes:
+    * O(n log k) time and O(k) memory, no heap over all the nodes.
+    * top_k returns the k first nodes in comp order (the k smallest by default, pass std::greater<T>()
+    * for the k largest), sorted by comp; fewer when the tree is smaller.
+    * With std::less / std::greater and a cached OrderKey (numbers, Complex) the candidates are compared
+    * by key, extracted once per node; other comparators compare the values.
+    * kth returns the k-th node in comp order, counting from 1; it throws std::out_of_range when k is 0
+    * or larger than the tree. Past the middle it selects the (n - k + 1)-th node in reversed order instead,
+    * so it holds O(min(k, n - k)) nodes.
+    */
+    template <typename Compare = std::less<T>>
+    std::vector<const node_type *> top_k(size_t k, Compare comp = Compare()) const
     {
-        bfs_nodes.clear();
-        bfs_helper(root, bfs_nodes);
-        return bfs_nodes.begin();
+        return select_nodes(k, comp, true);
     }
 
-    typename std::vector<Node<T> *>::iterator end_bfs_scan()
+    template <typename Compare = std::less<T>>
+    const node_type *kth(size_t k, Compare comp = Compare()) const
     {
-        return bfs_nodes.end();
+        size_t n = pool.size(); // nodes are never removed, so the pool counts the tree
+        if (k == 0 || k > n)
+            throw std::out_of_range("k is out of the range of the tree.");
+        if (k <= n / 2)
+            return select_nodes(k, comp, false).front();
+        auto reversed_comp = reversed(comp);
+        return select_nodes(n - k + 1, reversed_comp, false).front();
     }
 
-    typename std::vector<Node<T> *>::iterator begin_dfs_scan()
+    /*
+    * Level-synchronous parallel BFS: fills out with the nodes in the same order as begin_bfs_scan.
+    * Each level is a contiguous range of out. A wide level is cut into chunks; the chunks count their
+    * children in parallel, a prefix sum over the counts gives every chunk its output offset, and the chunks
+    * then copy their children into place in parallel, so no locks or per-thread buffers are needed.
+    * Levels narrower than PARALLEL_BFS_CUTOFF are expanded by the calling thread alone.
+    * Like heap_into this is const and reentrant, but the workers must not be shared by concurrent calls.
+    */
+    static constexpr size_t PARALLEL_BFS_CUTOFF = 4096;
+
+    void parallel_bfs_into(std::vector<const node_type *> &out, ThreadPool &workers) const
     {
-        dfs_nodes.clear();
-        dfs_helper(root, dfs_nodes);
-        return dfs_nodes.begin();
+        out.clear();
+        if (root == nullptr)
+            return;
+        out.push_back(root);
+        std::vector<size_t> offsets;
+        size_t level_begin = 0;
+        size_t level_end = 1;
+        while (level_begin < level_end)
+        {
+            size_t width = level_end - level_begin;
+            if (workers.size() == 1 || width < PARALLEL_BFS_CUTOFF)
+            {
+                for (size_t i = level_begin; i < level_end; i++)
+                {
+                    for (auto child : out[i]->get_children())
+                    {
+                        out.push_back(child);
+                    }
+                }
+            }
+            else
+            {
+                size_t chunks = std::min(workers.size() * 4, width / (PARALLEL_BFS_CUTOFF / 4));
+                auto chunk_begin = [=](size_t chunk) { return level_begin + width * chunk / chunks; };
+                offsets.assign(chunks + 1, 0);
+                workers.run(chunks, [&](size_t chunk) {
+                    size_t count = 0;
+                    for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++)
+                    {
+                        count += out[i]->child_count();
+                    }
+                    offsets[chunk + 1] = count;
+                });
+                offsets[0] = level_end;
+                for (size_t chunk = 0; chunk < chunks; chunk++)
+                {
+                    offsets[chunk + 1] += offsets[chunk];
+                }
+                out.resize(offsets[chunks]);
+                workers.run(chunks, [&](size_t chunk) {
+                    size_t next = offsets[chunk];
+                    for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); i++)
+                    {
+                        for (auto child : out[i]->get_children())
+                        {
+                            out[next++] = child;
+                        }
+                    }
+                });
+            }
+            level_begin = level_end;
+            level_end = out.size();
+        }
     }
 
-    typename std::vector<Node<T> *>::iterator end_dfs_scan()
+    /*
+    * Parallel reduction: combine(... combine(identity, map(v1)) ..., map(vn)) over the values of all nodes,
+    * e.g. a sum, a maximum or a node count. combine must be associative and commutative, because the nodes
+    * are partitioned between the threads in no fixed order.
+    * Every thread walks its subtrees depth-first with a private stack. After each PARALLEL_REDUCE_GRAIN nodes
+    * it checks for idle threads and, if there are any, hands the oldest half of its stack (the roots of the
+    * biggest pending subtrees) to its WorkStealingDeque, where the idle threads steal from. Small trees and
+    * single-thread pools are reduced sequentially.
+    */
+    static constexpr size_t PARALLEL_REDUCE_GRAIN = 1024;
+
+    template <typename Map, typename Combine, typename R>
+    R parallel_reduce(Map map, Combine combine, R identity, ThreadPool &workers) const
     {
-        return dfs_nodes.end();
+        std::vector<const node_type *> local;
+        if (root == nullptr)
+            return identity;
+        if (workers.size() == 1)
+            return reduce_subtree(root, map, combine, identity, local, [] { return false; });
+
+        std::vector<WorkStealingDeque<const node_type *>> deques(workers.size());
+        // One accumulator per worker, each on its own cache line (and never a std::vector<bool> bit).
+        struct alignas(64) Slot
+        {
+            R value;
+        };
+        std::vector<Slot> partial(workers.size(), Slot{identity});
+        std::atomic<size_t> pending(1); // subtrees queued or being reduced
+        std::atomic<size_t> idle(0);
+        std::atomic<bool> failed(false);
+        deques[0].push(root);
+
+        workers.run(workers.size(), [&](size_t worker) {
+            std::vector<const node_type *> stack;
+            bool waiting = false;
+            try
+            {
+                while (pending.load() != 0 && !failed.load())
+                {
+                    const node_type *subtree = nullptr;
+                    bool found = deques[worker].pop(subtree);
+                    for (size_t i = 1; !found && i < deques.size(); i++)
+                    {
+                        found = deques[(worker + i) % deques.size()].steal(subtree);
+                    }
+                    if (!found)
+                    {
+                        if (!waiting)
+                            idle++;
+                        waiting = true;
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    if (waiting)
+                        idle--;
+                    waiting = false;
+                    auto share = [&]() {
+                        if (idle.load() == 0 || stack.size() < 2)
+                            return false;
+                        size_t half = stack.size() / 2;
+                        pending += half;
+                        deques[worker].push(stack.begin(), stack.begin() + half);
+                        stack.erase(stack.begin(), stack.begin() + half);
+                        return true;
+                    };
+                    partial[worker].value = reduce_subtree(subtree, map, combine, partial[worker].value, stack, share);
+                    pending--;
+                }
+            }
+            catch (...)
+            {
+                failed = true;
+                throw;
+            }
+        });
+
+        R result = identity;
+        for (const auto &slot : partial)
+        {
+            result = combine(result, slot.value);
+        }
+        return result;
     }
 
-        typename std::vector<Node<T> *>::iterator begin_heap()
+    /*
+    * Morris traversals (binary trees only): visit every node in in-order / pre-order with O(1) extra memory.
+    * The tree is threaded while it runs: a node with fewer than two children temporarily points its free
+    * second child slot at its in-order successor. Every thread is removed again before returning, even when
+    * visit throws (the walk then finishes without visiting and the exception is rethrown).
+    * The tree must not be read by anyone else during the walk.
+    */
+    template <typename Visitor>
+    void morris_in_order(Visitor visit)
     {
-        heap_nodes.clear();
-        myHeap(root, heap_nodes);
-        return heap_nodes.begin();
+        morris_walk(visit, false);
     }
 
-    typename std::vector<Node<T> *>::iterator end_heap()
+    template <typename Visitor>
+    void morris_pre_order(Visitor visit)
     {
-        return heap_nodes.end();
+        morris_walk(visit, true);
     }
 
-    
 
 /*
     Helper functions for the tree traversal.
@@ -203,115 +670,330 @@ public:
 
 */
 private:
-    void pre_order_helper(Node<T> *node, std::vector<Node<T> *> &result)
+    template <typename Visitor>
+    void morris_walk(Visitor &visit, bool pre_order)
     {
-        if (node == nullptr)
-            return;
-        result.push_back(node);
-        for (auto child : node->get_children())
+        static_assert(K == 2, "Morris traversal needs a binary tree.");
+        std::exception_ptr failure;
+        auto emit = [&visit, &failure](node_type *node) {
+            if (failure)
+                return;
+            try
+            {
+                visit(node);
+            }
+            catch (...)
+            {
+                failure = std::current_exception();
+            }
+        };
+
+        // children[1] is the right child when there are two children, the thread slot otherwise.
+        node_type *current = root;
+        while (current != nullptr)
         {
-            pre_order_helper(child, result);
+            if (current->child_count() == 0)
+            {
+                emit(current);
+                current = current->children[1];
+                continue;
+            }
+            node_type *left = current->children[0];
+            node_type *predecessor = left;
+            while (predecessor->children[1] != nullptr && predecessor->children[1] != current)
+            {
+                predecessor = predecessor->children[1];
+            }
+            if (predecessor->children[1] == nullptr)
+            {
+                if (pre_order)
+                    emit(current);
+                predecessor->children[1] = current; // thread back to current
+                current = left;
+            }
+            else
+            {
+                predecessor->children[1] = nullptr; // left subtree done, remove the thread
+                if (!pre_order)
+                    emit(current);
+                current = current->children[1];
+            }
         }
+        if (failure)
+            std::rethrow_exception(failure);
     }
 
-    void post_order_helper(Node<T> *node, std::vector<Node<T> *> &result)
+    // The k first elements in less order, as a heap whose front is the largest of them.
+    template <typename E, typename Make, typename Less>
+    std::vector<E> select_k(size_t k, Make make, Less less, bool sort) const
     {
-        if (node == nullptr)
-            return;
-        for (auto child : node->get_children())
+        std::vector<E> selected;
+        if (k == 0)
+            return selected;
+        selected.reserve(std::min(k, pool.size()));
+        for (auto node = begin_dfs_scan(); node != end_dfs_scan(); ++node)
         {
-            post_order_helper(child, result);
+            E candidate = make(*node);
+            if (selected.size() < k)
+            {
+                selected.push_back(candidate);
+                std::push_heap(selected.begin(), selected.end(), less);
+            }
+            else if (less(candidate, selected.front()))
+            {
+                std::pop_heap(selected.begin(), selected.end(), less);
+                selected.back() = candidate;
+                std::push_heap(selected.begin(), selected.end(), less);
+            }
         }
-        result.push_back(node);
+        if (sort)
+            std::sort_heap(selected.begin(), selected.end(), less);
+        return selected;
     }
 
-     void in_order_helper(Node<T> *node, std::vector<Node<T> *> &result) {
-    if (node == nullptr)
-        return;
+    // comp with its arguments swapped; std::less and std::greater map to each other to keep the keyed path.
+    template <typename Compare>
+    static auto reversed(const Compare &comp)
+    {
+        if constexpr (std::is_same<Compare, std::less<T>>::value)
+            return std::greater<T>();
+        else if constexpr (std::is_same<Compare, std::greater<T>>::value)
+            return std::less<T>();
+        else
+            return [comp](const T &lhs, const T &rhs) { return comp(rhs, lhs); };
+    }
+
+    // top_k / kth: sorted, or as the select_k heap (front = k-th node).
+    template <typename Compare>
+    std::vector<const node_type *> select_nodes(size_t k, Compare &comp, bool sort) const
+    {
+        using key = OrderKey<T>;
+        constexpr bool ascending = std::is_same<Compare, std::less<T>>::value;
+        constexpr bool descending = std::is_same<Compare, std::greater<T>>::value;
+        if constexpr (key::cached && (ascending || descending))
+        {
+            using entry = typename const_heap_iterator::Entry;
+            auto before = [](const entry &lhs, const entry &rhs) {
+                return ascending ? key::less(lhs.order, rhs.order) : key::less(rhs.order, lhs.order);
+            };
+            std::vector<entry> selected = select_k<entry>(k, const_heap_iterator::entry, before, sort);
+            std::vector<const node_type *> nodes;
+            nodes.reserve(selected.size());
+            for (const auto &e : selected)
+            {
+                nodes.push_back(e.node);
+            }
+            return nodes;
+        }
+        else
+        {
+            auto same = [](const node_type *node) { return node; };
+            auto by_value = [&comp](const node_type *lhs, const node_type *rhs) { return comp(lhs->get_value(), rhs->get_value()); };
+            return select_k<const node_type *>(k, same, by_value, sort);
+        }
+    }
 
-    auto children = node->get_children();
-    if (children.size() > 0) {
-        in_order_helper(children[0], result); // Left child
+    // Sequential part of parallel_reduce: folds the subtree into acc, offering to share work every grain nodes.
+    template <typename Map, typename Combine, typename R, typename Share>
+    static R reduce_subtree(const node_type *subtree, Map &map, Combine &combine, R acc,
+                            std::vector<const node_type *> &stack, Share share)
+    {
+        stack.clear();
+        stack.push_back(subtree);
+        size_t since_share = 0;
+        while (!stack.empty())
+        {
+            const node_type *node = stack.back();
+            stack.pop_back();
+            acc = combine(acc, map(node->get_value()));
+            for (auto child : node->get_children())
+            {
+                stack.push_back(child);
+            }
+            if (++since_share == PARALLEL_REDUCE_GRAIN)
+            {
+                since_share = 0;
+                share();
+            }
+        }
+        return acc;
     }
-    result.push_back(node); // Root
-    if (children.size() > 1) {
-        in_order_helper(children[1], result); // Right child
+
+    // Rebuilds the cached heap if the tree changed since it was built.
+    void refresh_heap()
+    {
+        if (heap_version == version)
+        {
+            cache_hits++;
+            return;
+        }
+        cache_misses++;
+        heap_entries.clear();
+        myHeap(root, heap_entries);
+        heap_version = version;
     }
-}
 
+    /*
+    * The helpers below are iterative: they keep an explicit stack in work_stack instead of recursing,
+    * so degenerate trees (long chains) cannot overflow the call stack, and the buffer is reused between calls.
+    */
+    template <typename Visit>
+    void dfs_helper(node_type *node, Visit visit)
+    {
+        if (node == nullptr)
+            return;
+        work_stack.clear();
+        work_stack.push_back(node);
+        while (!work_stack.empty())
+        {
+            node_type *current = work_stack.back();
+            work_stack.pop_back();
+            visit(current);
+            push_children_reversed(current);
+        }
+    }
 
-    void bfs_helper(Node<T> *node, std::vector<Node<T> *> &result)
+    void delete_tree(node_type *node)
     {
         if (node == nullptr)
             return;
-        std::queue<Node<T> *> q;
-        q.push(node);
-        while (!q.empty())
+        work_stack.clear();
+        work_stack.push_back(node);
+        while (!work_stack.empty())
         {
-            Node<T> *current = q.front();
-            q.pop();
-            result.push_back(current);
+            node_type *current = work_stack.back();
+            work_stack.pop_back();
             for (auto child : current->get_children())
             {
-                q.push(child);
+                work_stack.push_back(child);
             }
+            pool.destroy(static_cast<stored_node *>(current));
         }
     }
 
-    void dfs_helper(Node<T> *node, std::vector<Node<T> *> &result)
+    // Pushes the children so that the first child is popped first (pre-order).
+    void push_children_reversed(node_type *node)
     {
-        if (node == nullptr)
-            return;
-        result.push_back(node);
-        for (auto child : node->get_children())
+        auto children = node->get_children();
+        for (size_t i = children.size(); i-- > 0;)
         {
-            dfs_helper(child, result);
+            work_stack.push_back(children[i]);
         }
     }
 
-    void delete_tree(Node<T> *node)
+    // O(1) guard against handles issued by another tree, whose nodes this tree does not own.
+    void check_owner(const NodeHandle &handle) const
     {
-        if (node == nullptr)
-            return;
-        for (auto child : node->get_children())
+        if (handle.valid() && handle.owner != this)
         {
-            delete_tree(child);
+            throw std::runtime_error("Node handle belongs to another tree.");
         }
-        delete node;
     }
 
-    Node<T> *find_node(Node<T> *node, const T &value)
+    // Creates a node holding value as the last child of parent_ptr.
+    node_type *attach(node_type *parent_ptr, const T &value)
     {
-        if (node == nullptr)
-            return nullptr;
-        if (node->get_value() == value)
-            return node;
-        for (auto child : node->get_children())
+        if (parent_ptr == nullptr)
         {
-            Node<T> *found = find_node(child, value);
-            if (found != nullptr)
-                return found;
+            throw std::runtime_error("Parent node not found.");
+        }
+
+        if (parent_ptr->child_count() >= (size_t)this->k)
+        {
+            throw std::runtime_error("Node has reached the maximum number of children.");
         }
-        return nullptr;
+        node_type *child_ptr = pool.create(value);
+        parent_ptr->add_child(child_ptr);
+        if constexpr (has_aggregate)
+        {
+            static_cast<AggregatedNode *>(child_ptr)->parent = parent_ptr;
+            refresh_aggregates(parent_ptr);
+        }
+        index_node(child_ptr);
+        version++;
+        return child_ptr;
+    }
+
+    // Recomputes the aggregates from node up to the root: O(K) per ancestor.
+    static void refresh_aggregates(node_type *node)
+    {
+        while (node != nullptr)
+        {
+            auto aggregated = static_cast<AggregatedNode *>(node);
+            aggregate_type value = aggregate_policy::lift(node->value);
+            for (auto child : node->get_children())
+            {
+                value = aggregate_policy::combine(value, static_cast<AggregatedNode *>(child)->aggregate);
+            }
+            aggregated->aggregate = value;
+            node = aggregated->parent;
+        }
+    }
+
+    // Finds the node holding value: through the value index when T is hashable, by search otherwise.
+    node_type *lookup(const T &value)
+    {
+        if constexpr (has_value_index)
+        {
+            if (!value_indexed)
+            {
+                try
+                {
+                    value_index.reserve(pool.size());
+                    pool.find_if([this](stored_node *node) {
+                        value_index.emplace(&node->value, node);
+                        return false;
+                    });
+                }
+                catch (...)
+                {
+                    value_index.clear(); // never trust a partial index
+                    throw;
+                }
+                value_indexed = true;
+            }
+            auto it = value_index.find(&value);
+            return it == value_index.end() ? nullptr : it->second;
+        }
+        else
+        {
+            return find_node(value);
+        }
+    }
+
+    void index_node(node_type *node)
+    {
+        if constexpr (has_value_index)
+        {
+            if (value_indexed)
+                value_index.emplace(&node->value, node); // keeps the first node with this value
+        }
+    }
+
+    /*
+    * First node holding value in creation order, or nullptr: a sweep over the pool's slots.
+    * Tree never destroys single nodes, so every slot holds a node of the tree.
+    */
+    node_type *find_node(const T &value) const
+    {
+        return pool.find_if([&value](const stored_node *node) { return node->value == value; });
     }
 
 
-        void myHeap(Node<T> *node, std::vector<Node<T> *> &result)
+    void myHeap(node_type *node, std::vector<heap_entry> &result)
     {
         if (node == nullptr)
             return;
-        dfs_helper(node, result);
-        auto comp = [](Node<T> *lhs, Node<T> *rhs) { return lhs->get_value() > rhs->get_value(); };
-        std::make_heap(result.begin(), result.end(), comp);
-        
+        dfs_helper(node, [&result](node_type *current) { result.push_back(heap_iterator::entry(current)); });
+        std::make_heap(result.begin(), result.end(), heap_iterator::later);
     }
 
     /*
     Stream operator: launches the GUI to visualize the tree.
     */
-    friend std::ostream &operator<<(std::ostream &os, Tree<T, K> &tree)
+    friend std::ostream &operator<<(std::ostream &os, Tree &tree)
     {
-        Node<T> *root = tree.getRoot();
+        node_type *root = tree.getRoot();
 
         if(root == nullptr)
         {
@@ -328,7 +1010,8 @@ private:
             return os;
         }
 
-        // Window initialization
+        // Window initialization; the labels of an earlier window used another font
+        tree.render_cache.reset();
         sf::RenderWindow window(sf::VideoMode(700, 700), "EX4");
         window.setVerticalSyncEnabled(true); // Attempt to enable vertical sync
         
@@ -354,87 +1037,176 @@ private:
 
     /*
     drawTree function: draws the tree on the window.
-    It calls the helper functions to calculate the positions of the nodes and draw them.
+    The layout and its vertex arrays are computed by refresh_layout only when the tree or the window size
+    changed since the last frame; other frames only submit the cached edges, discs and labels.
     */
 void drawTree(sf::RenderWindow &window, sf::Font &font)
 {
     if (this->root == nullptr) return;
 
-    // Create a map to store positions of each node
-    std::map<Node<T>*, sf::Vector2f> positions;
-    float start_x = window.getSize().x / 2;
-    float start_y = NODE_RADIUS * 2;
-    calculate_positions(this->root, positions, start_x, start_y, window.getSize().x / 4);
-
-    for (auto &entry : positions)
+    if (!render_cache)
+    {
+        render_cache = std::make_shared<RenderCache>();
+        build_disc_texture(render_cache->disc_texture);
+    }
+    RenderCache &cache = *render_cache;
+    refresh_layout(cache, window.getSize(), font);
+    window.draw(cache.edges);
+    window.draw(cache.discs, &cache.disc_texture);
+    for (const auto &label : cache.labels)
     {
-        draw_node(window, entry.first, entry.second, font, positions);
+        window.draw(label);
     }
 }
+
+// Lays the tree out again if it changed (version), the window was resized or the font is another one.
+void refresh_layout(RenderCache &cache, sf::Vector2u window_size, const sf::Font &font)
+{
+    if (cache.version == version && cache.size.x == window_size.x && cache.size.y == window_size.y &&
+        cache.font == &font)
+        return;
+    cache.layout.clear();
+    cache.labels.clear();
+    float start_x = window_size.x / 2;
+    float start_y = NODE_RADIUS * 2;
+    calculate_positions(this->root, cache, font, start_x, start_y, window_size.x / 4);
+    build_vertices(cache);
+    cache.version = version;
+    cache.size = window_size;
+    cache.font = &font;
+}
+
 /*
     calculate_positions function: calculates the positions of the nodes in the tree.
-    It uses a map to store the positions of each node.
-    it calculates the positions recursively by traversing the tree.
+    It appends one entry per node (position and parent entry) to the flat layout array of the cache, and
+    the node's label, centered on it, to its labels.
+    A node's children are spread horizontally below it, with the spacing halved at every level.
+    It walks the tree with an explicit stack of pending placements.
 */
-void calculate_positions(Node<T> *node, std::map<Node<T>*, sf::Vector2f> &positions, float x, float y, float horizontal_spacing)
+void calculate_positions(node_type *node, RenderCache &cache, const sf::Font &font, float x, float y, float horizontal_spacing)
 {
     if (node == nullptr) return;
 
-    positions[node] = sf::Vector2f(x, y);
-    float child_x = x - ((node->get_children().size() - 1) * horizontal_spacing / 2);
-    float child_y = y + NODE_RADIUS * 3;
-
-    for (auto child : node->get_children())
+    struct Placement
     {
-        calculate_positions(child, positions, child_x, child_y, horizontal_spacing / 2);
-        child_x += horizontal_spacing;
+        node_type *node;
+        size_t parent;
+        float x, y, spacing;
+    };
+    std::vector<Placement> pending;
+    pending.push_back(Placement{node, NO_PARENT, x, y, horizontal_spacing});
+    while (!pending.empty())
+    {
+        Placement current = pending.back();
+        pending.pop_back();
+        size_t index = cache.layout.size();
+        sf::Vector2f position(current.x, current.y);
+        cache.layout.push_back(LayoutEntry{position, current.parent});
+        cache.labels.push_back(make_label(current.node, position, font));
+
+        auto children = current.node->get_children();
+        float child_x = current.x - ((children.size() - 1) * current.spacing / 2);
+        float child_y = current.y + NODE_RADIUS * 3;
+        for (auto child : children)
+        {
+            pending.push_back(Placement{child, index, child_x, child_y, current.spacing / 2});
+            child_x += current.spacing;
+        }
     }
 }
-/*
-    draw_node function: draws the node on the window.
-    It uses the SFML library to draw the node and the text.
-*/
-void draw_node(sf::RenderWindow &window, Node<T> *node, sf::Vector2f position, sf::Font &font, const std::map<Node<T>*, sf::Vector2f> &positions)
-{
-    sf::CircleShape circle(NODE_RADIUS);
-    circle.setFillColor(sf::Color::Green);
-    circle.setOrigin(NODE_RADIUS, NODE_RADIUS);
-    circle.setPosition(position);
 
-    sf::Text text;
-    text.setFont(font);
+// Text shown in a node: strings as they are, other values with one decimal.
+static std::string node_label(const node_type *node)
+{
     if constexpr (std::is_same<T, std::string>::value)
     {
-        text.setString(node->get_value());
+        return node->value;
     }
     else
     {
         std::ostringstream oss;
-        oss << std::fixed << std::setprecision(1) << node->get_value();
-        text.setString(oss.str());
+        oss << std::fixed << std::setprecision(1) << node->value;
+        return oss.str();
     }
-    text.setCharacterSize(20);
-    text.setFillColor(sf::Color::Black);
-    text.setOrigin(text.getLocalBounds().width / 2, text.getLocalBounds().height / 2);
-    text.setPosition(position);
+}
 
-    window.draw(circle);
-    window.draw(text);
+/*
+    build_disc_texture function: renders a green disc of NODE_RADIUS on a transparent square once,
+    with an antialiased rim. Every node is then a quad textured with it.
+*/
+static void build_disc_texture(sf::Texture &texture)
+{
+    unsigned side = (unsigned)(2 * NODE_RADIUS);
+    sf::Image image;
+    image.create(side, side, sf::Color(0, 0, 0, 0));
+    for (unsigned y = 0; y < side; y++)
+    {
+        for (unsigned x = 0; x < side; x++)
+        {
+            float dx = x + 0.5f - NODE_RADIUS;
+            float dy = y + 0.5f - NODE_RADIUS;
+            float coverage = std::min(1.0f, std::max(0.0f, NODE_RADIUS - std::sqrt(dx * dx + dy * dy) + 0.5f));
+            sf::Color color = sf::Color::Green;
+            color.a = (unsigned char)(255 * coverage);
+            image.setPixel(x, y, color);
+        }
+    }
+    texture.loadFromImage(image);
+    texture.setSmooth(true);
+}
 
-    // Draw lines to children
-    // The lines are drawn using the positions map which contains the positions of each node.
-    
-    for (auto child : node->get_children())
+/*
+    build_vertices function: fills the vertex arrays of the cache from its layout.
+    Every edge is one sf::Lines pair from the parent's center to the child's, every node a quad around its
+    center (two triangles, 6 vertices) showing the disc texture.
+*/
+static void build_vertices(RenderCache &cache)
+{
+    const std::vector<LayoutEntry> &layout = cache.layout;
+    cache.edges.clear();
+    cache.discs.clear();
+    if (layout.empty()) return;
+    cache.edges.resize((layout.size() - 1) * 2);
+    cache.discs.resize(layout.size() * 6);
+
+    // Quad corners around the origin and their texture coordinates, in triangle order.
+    const float r = NODE_RADIUS;
+    const sf::Vector2f corners[6] = {{-r, -r}, {r, -r}, {r, r}, {-r, -r}, {r, r}, {-r, r}};
+
+    size_t edge = 0;
+    size_t vertex = 0;
+    for (const auto &entry : layout)
     {
-        sf::Vertex line[] =
+        const sf::Vector2f &center = entry.position;
+        if (entry.parent != NO_PARENT)
         {
-            sf::Vertex(position),
-            sf::Vertex(positions.at(child))
-        };
-        window.draw(line, 2, sf::Lines);
+            cache.edges[edge++] = sf::Vertex(layout[entry.parent].position);
+            cache.edges[edge++] = sf::Vertex(center);
+        }
+        for (const auto &corner : corners)
+        {
+            cache.discs[vertex++] = sf::Vertex(sf::Vector2f(center.x + corner.x, center.y + corner.y),
+                                               sf::Vector2f(corner.x + r, corner.y + r));
+        }
     }
 }
 
+/*
+    make_label function: the text of a node, centered on position.
+    Laying out the glyphs happens here, once per layout, not in every frame.
+*/
+static sf::Text make_label(const node_type *node, sf::Vector2f position, const sf::Font &font)
+{
+    sf::Text text;
+    text.setFont(font);
+    text.setString(node_label(node));
+    text.setCharacterSize(20);
+    text.setFillColor(sf::Color::Black);
+    text.setOrigin(text.getLocalBounds().width / 2, text.getLocalBounds().height / 2);
+    text.setPosition(position);
+    return text;
+}
+
 };
 
 #endif // TREE_HPP
@@ -0,0 +1,290 @@
+#ifndef TREE_ITERATORS_HPP
+#define TREE_ITERATORS_HPP
+
+#include "order_key.hpp"
+#include "implicit_index.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    Lazy traversal iterators.
+    They keep an explicit stack (depth-first orders) or queue (breadth-first) and advance one node per ++,
+    so nothing is materialized up front and a loop can stop early.
+    Dereferencing yields the node pointer. A default constructed iterator is the end iterator.
+    Adding children to the tree invalidates the iterators that are in use.
+
+    N is the node type: anything with get_children() returning an indexable view of N*.
+*/
+
+enum class DepthFirstOrder
+{
+    PreOrder,  // node, then its children
+    InOrder,   // first child, node, remaining children (left, root, right for binary trees)
+    PostOrder  // children, then the node
+};
+
+template <typename N>
+class DepthFirstIterator
+{
+private:
+    struct Frame
+    {
+        N *node;
+        std::size_t next; // index of the next child to descend into
+        bool visited;     // the node itself was already yielded
+    };
+
+    std::vector<Frame> stack; // O(depth) frames; the top one is the current node
+    DepthFirstOrder order;
+
+    // Number of children that must be finished before the node itself is yielded.
+    std::size_t visit_index(std::size_t child_count) const
+    {
+        switch (order)
+        {
+        case DepthFirstOrder::PreOrder:
+            return 0;
+        case DepthFirstOrder::InOrder:
+            return child_count > 0 ? 1 : 0;
+        default:
+            return child_count;
+        }
+    }
+
+    // Walks down / unwinds until the top frame is the next node to yield, or the stack is empty.
+    void settle()
+    {
+        while (!stack.empty())
+        {
+            Frame &top = stack.back();
+            auto children = top.node->get_children();
+            if (!top.visited && top.next == visit_index(children.size()))
+                return;
+            if (top.next < children.size())
+            {
+                N *child = children[top.next++];
+                stack.push_back(Frame{child, 0, false});
+                continue;
+            }
+            stack.pop_back();
+        }
+    }
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = N *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = N *const *;
+    using reference = N *const &;
+
+    DepthFirstIterator() : order(DepthFirstOrder::PreOrder) {}
+
+    DepthFirstIterator(N *root, DepthFirstOrder traversal_order) : order(traversal_order)
+    {
+        if (root == nullptr)
+            return;
+        stack.reserve(16);
+        stack.push_back(Frame{root, 0, false});
+        settle();
+    }
+
+    N *current() const { return stack.empty() ? nullptr : stack.back().node; }
+
+    N *operator*() const { return stack.back().node; }
+
+    DepthFirstIterator &operator++()
+    {
+        stack.back().visited = true;
+        settle();
+        return *this;
+    }
+
+    DepthFirstIterator operator++(int)
+    {
+        DepthFirstIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const DepthFirstIterator &other) const { return current() == other.current(); }
+    bool operator!=(const DepthFirstIterator &other) const { return !(*this == other); }
+};
+
+/*
+    BreadthFirstIterator: level order, using a power-of-two ring buffer as the queue.
+    Memory is O(widest level) and the buffer only reallocates when a level outgrows it.
+*/
+template <typename N>
+class BreadthFirstIterator
+{
+private:
+    std::vector<N *> ring;
+    std::size_t head;
+    std::size_t count;
+
+    void push(N *node)
+    {
+        if (count == ring.size())
+        {
+            std::vector<N *> grown(ring.empty() ? 16 : ring.size() * 2);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                grown[i] = ring[(head + i) & (ring.size() - 1)];
+            }
+            ring.swap(grown);
+            head = 0;
+        }
+        ring[(head + count) & (ring.size() - 1)] = node;
+        count++;
+    }
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = N *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = N *const *;
+    using reference = N *const &;
+
+    BreadthFirstIterator() : head(0), count(0) {}
+
+    explicit BreadthFirstIterator(N *root) : head(0), count(0)
+    {
+        if (root != nullptr)
+            push(root);
+    }
+
+    N *current() const { return count == 0 ? nullptr : ring[head]; }
+
+    N *operator*() const { return ring[head]; }
+
+    BreadthFirstIterator &operator++()
+    {
+        N *node = ring[head];
+        head = (head + 1) & (ring.size() - 1);
+        count--;
+        for (auto child : node->get_children())
+        {
+            push(child);
+        }
+        return *this;
+    }
+
+    BreadthFirstIterator operator++(int)
+    {
+        BreadthFirstIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const BreadthFirstIterator &other) const { return current() == other.current(); }
+    bool operator!=(const BreadthFirstIterator &other) const { return !(*this == other); }
+};
+
+/*
+    HeapIterator: yields the nodes in ascending order of their values, without sorting them up front.
+    It walks a min-heap of (OrderKey, node) entries - each node's key is extracted once when the entry is
+    made - and never modifies it: a small frontier heap holds the entries whose parents were already
+    yielded, so the next node is the frontier's smallest entry. ++ pops it and pushes its two children,
+    so the first k nodes cost O(k log k) however large the heap is.
+    The heap is either borrowed (the tree's cache, which must then outlive the iterator and stay unchanged)
+    or owned and shared by the copies of the iterator. Copying the iterator copies the frontier only.
+*/
+template <typename N>
+class HeapIterator
+{
+public:
+    using key = OrderKey<typename std::remove_cv<typename std::remove_reference<decltype(std::declval<N &>().get_value())>::type>::type>;
+
+    struct Entry
+    {
+        typename key::type order;
+        N *node;
+    };
+
+    // Orders entries for std::make_heap & co. so that the smallest key is at the front.
+    static bool later(const Entry &lhs, const Entry &rhs) { return key::less(rhs.order, lhs.order); }
+
+    static Entry entry(N *node) { return Entry{key::of(node->value), node}; } // keys may point into the node
+
+private:
+    // std::make_heap lays out a binary heap: the children of entry i are 2i+1 and 2i+2.
+    using index = ImplicitIndex<2>;
+
+    std::shared_ptr<const std::vector<Entry>> owned; // null when the heap is borrowed
+    const std::vector<Entry> *heap;
+    // Entries whose parents were yielded, with their heap index; itself a heap (front = smallest).
+    // Keeping a copy of the entry makes the frontier's sifts local, no lookups into the walked heap.
+    struct Pending
+    {
+        Entry entry;
+        std::size_t index;
+    };
+    std::vector<Pending> frontier;
+
+    static bool pending_later(const Pending &lhs, const Pending &rhs) { return later(lhs.entry, rhs.entry); }
+
+    void push(std::size_t i)
+    {
+        frontier.push_back(Pending{(*heap)[i], i});
+        std::push_heap(frontier.begin(), frontier.end(), pending_later);
+    }
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = N *;
+    using difference_type = std::ptrdiff_t;
+    using pointer = N *const *;
+    using reference = N *const &;
+
+    HeapIterator() : heap(nullptr) {}
+
+    // Walks entries in place; they must already form a heap (see later).
+    explicit HeapIterator(const std::vector<Entry> *entries) : heap(entries)
+    {
+        if (!heap->empty())
+            push(0);
+    }
+
+    // Takes entries in any order, heapifies them and owns them.
+    explicit HeapIterator(std::vector<Entry> entries)
+    {
+        std::make_heap(entries.begin(), entries.end(), later);
+        owned = std::make_shared<const std::vector<Entry>>(std::move(entries));
+        heap = owned.get();
+        if (!heap->empty())
+            push(0);
+    }
+
+    N *current() const { return frontier.empty() ? nullptr : frontier.front().entry.node; }
+
+    N *operator*() const { return frontier.front().entry.node; }
+
+    HeapIterator &operator++()
+    {
+        std::size_t top = frontier.front().index;
+        std::pop_heap(frontier.begin(), frontier.end(), pending_later);
+        frontier.pop_back();
+        for (std::size_t child = index::first_child(top); child <= index::child(top, 1) && child < heap->size(); child++)
+        {
+            push(child);
+        }
+        return *this;
+    }
+
+    HeapIterator operator++(int)
+    {
+        HeapIterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    bool operator==(const HeapIterator &other) const { return current() == other.current(); }
+    bool operator!=(const HeapIterator &other) const { return !(*this == other); }
+};
+
+#endif // TREE_ITERATORS_HPP